@@ -0,0 +1,355 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "api.h"
+#include "bitboard.h"
+#include "cluster.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "thread.h"
+#include "uci.h"
+#include "variant.h"
+#include "syzygy/tbprobe.h"
+
+/// fsf_position is a position with the moves played from its root position,
+/// so that a search can be given the positions before it.
+
+struct fsf_position {
+  Position pos;
+  std::string fen;              // Of the root position
+  std::vector<Move> moves;
+  std::deque<StateInfo> states; // Of the root position and after each move
+};
+
+namespace {
+
+  // Thread of all the library positions, which count their moves on it. It
+  // never searches, so that using positions does not disturb a search.
+  Thread* PositionThread;
+
+  std::once_flag InitFlag;
+  Mutex SearchMutex; // Held while a search runs or options change
+  Mutex AsyncMutex;  // Guards the asynchronous search
+  std::thread AsyncSearch;
+  fsf_result AsyncResult;
+  std::atomic_bool StopRequested;
+
+  // The engine writes its output to std::cout. The buffer of std::cout is
+  // replaced by an OutputBuf while the library runs engine code, which passes
+  // each line to the output function, if any.
+
+  class OutputBuf : public std::streambuf {
+
+  public:
+    OutputBuf(fsf_output o, void* d) : out(o), data(d), prev(std::cout.rdbuf(this)) {}
+   ~OutputBuf() { std::cout.rdbuf(prev); }
+
+  private:
+    int overflow(int c) override {
+
+      if (c == '\n')
+      {
+          if (out)
+              out(line.c_str(), data);
+          line.clear();
+      }
+      else if (c != traits_type::eof())
+          line += char(c);
+
+      return traits_type::not_eof(c);
+    }
+
+    fsf_output out;
+    void* data;
+    std::streambuf* prev;
+    std::string line;
+  };
+
+  struct Game {
+    const Variant* variant;
+    std::string fen;
+    bool chess960;
+    std::vector<Move> moves;
+  };
+
+  size_t copy_string(const std::string& s, char* buf, size_t size) {
+
+    if (size)
+    {
+        size_t n = s.copy(buf, size - 1);
+        buf[n] = '\0';
+    }
+    return s.size();
+  }
+
+  // search() runs a search of the last position of the game, replaying the game
+  // so that the search knows the positions before it, e.g. for repetitions.
+
+  void search(const Game& game, const fsf_limits& l, fsf_output out, void* data, fsf_result* result) {
+
+    Search::LimitsType limits;
+    limits.startTime = now();
+    limits.depth = l.depth;
+    limits.nodes = int64_t(l.nodes);
+    limits.movetime = l.movetime;
+    limits.movestogo = l.movestogo;
+    for (Color c : { WHITE, BLACK })
+        limits.time[c] = l.time[c], limits.inc[c] = l.inc[c];
+    limits.infinite = !(limits.depth | limits.nodes | limits.movetime | limits.time[WHITE] | limits.time[BLACK]);
+
+    std::lock_guard<Mutex> lk(SearchMutex);
+    OutputBuf buf(out, data);
+
+    StateListPtr states(new std::deque<StateInfo>(1));
+    Position pos;
+    pos.set(game.variant, game.fen, game.chess960, &states->back(), PositionThread);
+    for (Move m : game.moves)
+    {
+        states->emplace_back();
+        pos.do_move(m, states->back());
+    }
+
+    Threads.start_thinking(pos, states, limits);
+
+    // A stop requested before the search started would have been reset
+    if (StopRequested)
+        Threads.stop = true;
+
+    Threads.main()->wait_for_search_finished();
+
+    if (!result)
+        return;
+
+    const Thread* best = Threads.main()->bestThread;
+    const Search::RootMove& rm = best->rootMoves[0];
+    Value v = rm.score;
+
+    result->bestmove = rm.pv[0];
+    result->ponder = rm.pv.size() > 1 ? rm.pv[1] : MOVE_NONE;
+    result->depth = best->completedDepth / ONE_PLY;
+    result->nodes = Threads.nodes_searched();
+    result->score = v == -VALUE_INFINITE || abs(v) >= VALUE_MATE - MAX_PLY ? 0 : v * 100 / PawnValueEg;
+    result->mate =  v == -VALUE_INFINITE || abs(v) <  VALUE_MATE - MAX_PLY ? 0
+                  : (v > 0 ? VALUE_MATE - v + 1 : -VALUE_MATE - v - 1) / 2;
+  }
+
+} // namespace
+
+
+/// fsf_init() runs the initialization of main(), with the output silenced
+
+void fsf_init() {
+
+  std::call_once(InitFlag, []() {
+      OutputBuf buf(nullptr, nullptr);
+
+      Cluster::init();
+      Bitboards::init();
+      Position::init();
+      variants.init(); // After Zobrist keys are set
+      UCI::init(Options);
+      Bitbases::init();
+      Search::init();
+      Pawns::init();
+      Tablebases::init(Options["SyzygyPath"]); // After Bitboards are set
+      Threads.set(Options["Threads"]);
+      Search::clear(); // After threads are up
+      PositionThread = new Thread(0);
+  });
+}
+
+
+/// fsf_exit() releases what fsf_init() set up. All positions have to be deleted
+/// before, since they refer to the variants.
+
+void fsf_exit() {
+
+  fsf_search_wait(nullptr);
+  Threads.set(0);
+  delete PositionThread;
+  variants.clear_all();
+  Cluster::finalize();
+}
+
+
+int fsf_set_option(const char* name, const char* value) {
+
+  std::lock_guard<Mutex> lk(SearchMutex);
+  OutputBuf buf(nullptr, nullptr);
+
+  if (!Options.count(name))
+      return 0;
+
+  Options[name] = std::string(value);
+  return 1;
+}
+
+
+fsf_position* fsf_new_position(const char* variant, const char* fen, int chess960) {
+
+  auto it = variants.find(variant);
+  if (it == variants.end())
+      return nullptr;
+
+  fsf_position* p = new fsf_position;
+  p->fen = fen ? fen : it->second->startFen;
+  p->states.emplace_back();
+  p->pos.set(it->second, p->fen, chess960, &p->states.back(), PositionThread);
+  return p;
+}
+
+
+void fsf_delete_position(fsf_position* p) {
+  delete p;
+}
+
+
+size_t fsf_legal_moves(const fsf_position* p, fsf_move* moves, size_t size) {
+
+  MoveList<LEGAL> list(p->pos);
+  size_t cnt = 0;
+
+  for (const auto& m : list)
+      if (cnt < size)
+          moves[cnt++] = fsf_move(m.move);
+
+  return list.size();
+}
+
+
+int fsf_do_move(fsf_position* p, fsf_move m) {
+
+  if (!MoveList<LEGAL>(p->pos).contains(Move(m)))
+      return 0;
+
+  p->states.emplace_back();
+  p->pos.do_move(Move(m), p->states.back());
+  p->moves.push_back(Move(m));
+  return 1;
+}
+
+
+int fsf_undo_move(fsf_position* p) {
+
+  if (p->moves.empty())
+      return 0;
+
+  p->pos.undo_move(p->moves.back());
+  p->moves.pop_back();
+  p->states.pop_back();
+  return 1;
+}
+
+
+fsf_move fsf_to_move(const fsf_position* p, const char* name) {
+
+  std::string str(name);
+  return fsf_move(UCI::to_move(p->pos, str));
+}
+
+
+size_t fsf_move_name(const fsf_position* p, fsf_move m, char* buf, size_t size) {
+  return copy_string(UCI::move(p->pos, Move(m)), buf, size);
+}
+
+
+size_t fsf_fen(const fsf_position* p, char* buf, size_t size) {
+  return copy_string(p->pos.fen(), buf, size);
+}
+
+
+int fsf_side_to_move(const fsf_position* p) {
+  return p->pos.side_to_move() == WHITE ? 0 : 1;
+}
+
+
+int fsf_in_check(const fsf_position* p) {
+  return bool(p->pos.checkers());
+}
+
+
+int fsf_game_end(const fsf_position* p, int* result) {
+
+  Value v = VALUE_DRAW;
+  bool end = p->pos.is_game_end(v);
+
+  if (!end && !MoveList<LEGAL>(p->pos).size())
+  {
+      end = true;
+      v = p->pos.checkers() ? p->pos.checkmate_value() : p->pos.stalemate_value();
+  }
+
+  if (end && result)
+      *result = v > VALUE_DRAW ? 1 : v < VALUE_DRAW ? -1 : 0;
+
+  return end;
+}
+
+
+void fsf_search(const fsf_position* p, const fsf_limits* limits, fsf_output out, void* data, fsf_result* result) {
+
+  StopRequested = false;
+  search({ p->pos.variant(), p->fen, p->pos.is_chess960(), p->moves }, *limits, out, data, result);
+}
+
+
+/// fsf_search_start() first waits for the previous asynchronous search, if any
+
+void fsf_search_start(const fsf_position* p, const fsf_limits* limits, fsf_output out, void* data) {
+
+  std::lock_guard<Mutex> lk(AsyncMutex);
+
+  if (AsyncSearch.joinable())
+      AsyncSearch.join();
+
+  StopRequested = false;
+  Game game = { p->pos.variant(), p->fen, p->pos.is_chess960(), p->moves };
+  fsf_limits l = *limits;
+  AsyncSearch = std::thread([=]() { search(game, l, out, data, &AsyncResult); });
+}
+
+
+void fsf_search_wait(fsf_result* result) {
+
+  std::lock_guard<Mutex> lk(AsyncMutex);
+
+  if (AsyncSearch.joinable())
+      AsyncSearch.join();
+
+  if (result)
+      *result = AsyncResult;
+}
+
+
+void fsf_search_stop() {
+
+  StopRequested = true;
+  Threads.stop = true;
+}
@@ -0,0 +1,140 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef API_H_INCLUDED
+#define API_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// C interface of the engine library, built with "make lib", for programs that
+/// need move generation, game end detection or searches without running the
+/// engine as a separate process and talking UCI to it.
+///
+/// Positions are independent objects: different positions can be used from
+/// different threads at the same time, a single position only from one thread
+/// at a time. Searches use the search threads and the hash of the engine, so
+/// only one search runs at a time and further ones wait for it. The searched
+/// position is copied, so that it can be changed while an asynchronous search
+/// is running. Options must not be changed while other calls are running.
+///
+/// Moves are the internal move encoding of the build, they are only meaningful
+/// for the position they were generated for. 0 is no move.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fsf_position fsf_position;
+typedef uint32_t fsf_move;
+
+/// fsf_limits are the limits of a search, like the arguments of "go". Times are
+/// in milliseconds, zero means no limit. Without any limit the search runs until
+/// fsf_search_stop() is called.
+
+typedef struct {
+  int depth;
+  uint64_t nodes;
+  int64_t movetime;
+  int64_t time[2], inc[2]; // Clock of white and black
+  int movestogo;
+} fsf_limits;
+
+/// fsf_result is the outcome of a search. The score is from the point of view
+/// of the side to move, either in centipawns or, if 'mate' is not zero, as
+/// moves to mate, negative when getting mated.
+
+typedef struct {
+  fsf_move bestmove, ponder;
+  int depth;
+  int score;
+  int mate;
+  uint64_t nodes;
+} fsf_result;
+
+/// fsf_output is called with each line of the engine output during a search,
+/// e.g. "info depth 10 ...", from the search thread. The last line of a search
+/// is its "bestmove".
+
+typedef void (*fsf_output)(const char* line, void* data);
+
+/// fsf_init() initializes the engine and has to be called first, fsf_exit()
+/// stops the search threads at the end. fsf_set_option() sets a UCI option,
+/// e.g. "Threads" or "Hash", and returns 0 if there is no such option.
+
+void fsf_init(void);
+void fsf_exit(void);
+int fsf_set_option(const char* name, const char* value);
+
+/// fsf_new_position() sets up a position of the variant given by name, from
+/// the given FEN or from the start position if 'fen' is NULL. It returns NULL
+/// if the variant is unknown. The FEN is not validated.
+
+fsf_position* fsf_new_position(const char* variant, const char* fen, int chess960);
+void fsf_delete_position(fsf_position* pos);
+
+/// fsf_legal_moves() stores up to 'size' legal moves in 'moves' and returns the
+/// number of legal moves, which may be larger than 'size'.
+
+size_t fsf_legal_moves(const fsf_position* pos, fsf_move* moves, size_t size);
+
+/// fsf_do_move() plays a move and fsf_undo_move() takes back the last one, they
+/// return 0 if the move is not legal or if there is no move to take back.
+
+int fsf_do_move(fsf_position* pos, fsf_move m);
+int fsf_undo_move(fsf_position* pos);
+
+/// fsf_to_move() converts a move in coordinate notation, e.g. "e2e4" or "P@e4",
+/// to the legal move it stands for, or 0. fsf_move_name() and fsf_fen() write
+/// the move and the FEN of the position as a null-terminated string, truncated
+/// to 'size' bytes, and return the length of the full string, like snprintf().
+
+fsf_move fsf_to_move(const fsf_position* pos, const char* name);
+size_t fsf_move_name(const fsf_position* pos, fsf_move m, char* buf, size_t size);
+size_t fsf_fen(const fsf_position* pos, char* buf, size_t size);
+
+/// fsf_side_to_move() returns 0 for white and 1 for black, fsf_in_check()
+/// whether the side to move is in check. fsf_game_end() returns whether the game
+/// has ended, including by optional rules like repetitions or the n-move rule,
+/// and if so stores in 'result' 1, 0 or -1 for a win, draw or loss of the side
+/// to move.
+
+int fsf_side_to_move(const fsf_position* pos);
+int fsf_in_check(const fsf_position* pos);
+int fsf_game_end(const fsf_position* pos, int* result);
+
+/// fsf_search() searches a position and waits for the result, which is stored
+/// in 'result' unless it is NULL. fsf_search_start() starts a search and returns
+/// immediately, fsf_search_wait() waits for its result and fsf_search_stop()
+/// makes the running search return as soon as possible. The best move is 0 if
+/// the game has ended. The output of the engine goes to the output function,
+/// which may be NULL, instead of standard output: std::cout of the process is
+/// redirected while a search runs.
+
+void fsf_search(const fsf_position* pos, const fsf_limits* limits, fsf_output out, void* data, fsf_result* result);
+void fsf_search_start(const fsf_position* pos, const fsf_limits* limits, fsf_output out, void* data);
+void fsf_search_wait(fsf_result* result);
+void fsf_search_stop(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // #ifndef API_H_INCLUDED
@@ -18,13 +18,19 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <deque>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <istream>
+#include <sstream>
 #include <vector>
 
+#include "movegen.h"
 #include "position.h"
+#include "thread.h"
 #include "uci.h"
+#include "syzygy/tbprobe.h"
 
 using namespace std;
 
@@ -88,6 +94,72 @@ const vector<string> Defaults = {
   "setoption name UCI_Chess960 value false"
 };
 
+
+// Variants skipped by perftbench unless given by name, since they are other
+// names of a variant or differ from one only in moves that cannot be reached
+// from the start position at the depths of the bench
+const vector<string> PerftAliases = { "standard", "mini", "loop", "antichess" };
+
+// Leaf node counts of a perft run, split by move type
+struct PerftStats {
+  uint64_t nodes, quiets, captures, drops, promotions;
+};
+
+void perft(Position& pos, int depth, PerftStats& stats) {
+
+  StateInfo st;
+
+  for (const auto& m : MoveList<LEGAL>(pos))
+      if (depth > 1)
+      {
+          pos.do_move(m, st);
+          perft(pos, depth - 1, stats);
+          pos.undo_move(m);
+      }
+      else
+      {
+          stats.nodes++;
+          if (type_of(m) == DROP)
+              stats.drops++;
+          else if (type_of(m) == PROMOTION || type_of(m) == PIECE_PROMOTION)
+              stats.promotions++;
+          else if (pos.capture(m))
+              stats.captures++;
+          else
+              stats.quiets++;
+      }
+}
+
+// Generate moves of the given type in all the positions of the perft tree,
+// except for the leaves. EVASIONS are generated only in positions with the
+// side to move in check, all the other types only in positions without check.
+template<GenType Type>
+void generate_all(Position& pos, int depth, uint64_t& cnt) {
+
+  StateInfo st;
+  ExtMove moves[MAX_MOVES];
+
+  if ((Type == EVASIONS) == bool(pos.checkers()))
+      cnt += generate<Type>(pos, moves) - moves;
+
+  if (depth > 1)
+      for (const auto& m : MoveList<LEGAL>(pos))
+      {
+          pos.do_move(m, st);
+          generate_all<Type>(pos, depth - 1, cnt);
+          pos.undo_move(m);
+      }
+}
+
+template<GenType Type>
+uint64_t generate_kmps(Position& pos, int depth) {
+
+  uint64_t cnt = 0;
+  TimePoint elapsed = now();
+  generate_all<Type>(pos, depth, cnt);
+  return cnt / (now() - elapsed + 1);
+}
+
 } // namespace
 
 /// setup_bench() builds a list of UCI commands to be run by bench. There
@@ -175,3 +247,202 @@ vector<string> setup_bench(const Position& current, istream& is) {
 
   return list;
 }
+
+
+/// perft_bench() runs perft from the start position of the given variants, or
+/// of all variants but aliases if none is given, to measure the speed of move
+/// generation. For each variant it reports the leaf nodes by move type, the
+/// perft speed and the speed of each generation stage in thousands of moves
+/// per second.
+/// Since the latter includes walking the perft tree, it is only meaningful
+/// for comparing builds, not as an absolute figure.
+
+void perft_bench(istream& is) {
+
+  vector<string> names;
+  string token;
+  int depth = 4;
+
+  // The depth is optional, so the first argument may already be a variant
+  for (bool first = true; is >> token; first = false)
+  {
+      istringstream ss(token);
+      int d;
+
+      if (first && ss >> d && ss.eof())
+          depth = std::max(d, 1);
+      else if (variants.find(token) != variants.end())
+          names.push_back(token);
+      else
+          sync_cout << "info string Unknown variant " << token << sync_endl;
+  }
+
+  if (names.empty())
+      for (const string& name : variants.get_keys())
+          if (find(PerftAliases.begin(), PerftAliases.end(), name) == PerftAliases.end())
+              names.push_back(name);
+
+  sync_cout << setw(16) << left << "Variant" << right
+            << setw(12) << "Nodes" << setw(10) << "Knps"
+            << setw(11) << "Quiets" << setw(11) << "Captures"
+            << setw(11) << "Drops" << setw(11) << "Promotions"
+            << setw(11) << "Captures/s" << setw(11) << "Quiets/s"
+            << setw(11) << "Checks/s" << setw(11) << "Evasions/s"
+            << setw(11) << "NonEvas/s" << sync_endl;
+
+  PerftStats total = {};
+  TimePoint totalTime = 0;
+
+  for (const string& name : names)
+  {
+      const Variant* v = variants.find(name)->second;
+      StateInfo st;
+      Position pos;
+      pos.set(v, v->startFen, false, &st, Threads.main());
+
+      PerftStats stats = {};
+      TimePoint elapsed = now();
+      perft(pos, depth, stats);
+      elapsed = now() - elapsed + 1;
+
+      total.nodes += stats.nodes;
+      totalTime += elapsed;
+
+      sync_cout << setw(16) << left << name << right
+                << setw(12) << stats.nodes << setw(10) << stats.nodes / elapsed
+                << setw(11) << stats.quiets << setw(11) << stats.captures
+                << setw(11) << stats.drops << setw(11) << stats.promotions
+                << setw(11) << generate_kmps<CAPTURES>(pos, depth)
+                << setw(11) << generate_kmps<QUIETS>(pos, depth)
+                << setw(11) << generate_kmps<QUIET_CHECKS>(pos, depth)
+                << setw(11) << generate_kmps<EVASIONS>(pos, depth)
+                << setw(11) << generate_kmps<NON_EVASIONS>(pos, depth) << sync_endl;
+  }
+
+  sync_cout << "\nPerft depth     : " << depth
+            << "\nTotal time (ms) : " << totalTime
+            << "\nNodes searched  : " << total.nodes
+            << "\nNodes/second    : " << 1000 * total.nodes / (totalTime + 1) << sync_endl;
+}
+
+
+/// analyze() searches a batch of positions read from a file, or from the
+/// standard input up to a line "end". Each line holds a FEN, or "startpos",
+/// optionally preceded by a variant name, the current variant being the default.
+///
+/// analyze [depth 10] [threads N] [file <path>]
+///
+/// The positions are searched one after the other to a fixed depth like with
+/// "go depth", by the given number of threads or those of the Threads option,
+/// each with the search parameters of its variant and the tablebases. The
+/// transposition table and the histories are kept from one position to the
+/// next, which helps when consecutive positions are similar. Instead of the
+/// usual output, one line is written per position:
+///
+/// analysis <line> variant <name> depth <d> score <score> nodes <n> bestmove <move> pv <moves>
+
+void analyze(istream& is) {
+
+  Search::LimitsType limits;
+  int userThreads = int(Options["Threads"]), threadCnt = userThreads;
+  string token, fname;
+  limits.depth = 10;
+
+  while (is >> token)
+      if (token == "depth")        is >> limits.depth;
+      else if (token == "threads") is >> threadCnt;
+      else if (token == "file")    getline(is >> ws, fname);
+
+  ifstream file;
+  if (!fname.empty())
+  {
+      file.open(fname);
+      if (!file)
+      {
+          sync_cout << "info string Unable to open file " << fname << sync_endl;
+          return;
+      }
+  }
+  istream& in = fname.empty() ? cin : file;
+
+  limits.depth = std::max(limits.depth, 1);
+  limits.batch = 1;
+
+  // The thread count of the Threads option is restored at the end
+  threadCnt = std::max(std::min(threadCnt, 512), 1);
+  if (threadCnt != userThreads)
+      Options["Threads"] = std::to_string(threadCnt);
+
+  const string defaultVariant = Options["UCI_Variant"];
+  const bool chess960 = Options["UCI_Chess960"];
+  uint64_t lineNb = 0, posCnt = 0, nodes = 0;
+  string line, varname, fen;
+  TimePoint elapsed = now();
+
+  while (getline(in, line) && line != "end")
+  {
+      ++lineNb;
+      if (line.find_first_not_of(" \t\r") == string::npos)
+          continue;
+
+      istringstream ss(line);
+      ss >> ws;
+      streampos start = ss.tellg();
+      if (!(ss >> varname) || variants.find(varname) == variants.end())
+          varname = defaultVariant, ss.clear(), ss.seekg(start);
+
+      const Variant* v = variants.find(varname)->second;
+      getline(ss >> ws, fen);
+      if (fen.empty() || fen.compare(0, 8, "startpos") == 0)
+          fen = v->startFen;
+
+      StateListPtr states(new std::deque<StateInfo>(1));
+      Position pos;
+      pos.set(v, fen, chess960, &states->back(), Threads.main());
+
+      stringstream out;
+      out << "analysis " << lineNb << " variant " << varname;
+
+      if (!MoveList<LEGAL>(pos).size())
+      {
+          Value result;
+          out << " depth 0 score "
+              << UCI::value(  pos.is_game_end(result) ? result
+                            : pos.checkers() ? pos.checkmate_value() : pos.stalemate_value())
+              << " nodes 0 bestmove (none)";
+      }
+      else
+      {
+          limits.startTime = now();
+          Threads.start_thinking(pos, states, limits);
+          Threads.main()->wait_for_search_finished();
+
+          const Thread* best = Threads.main()->bestThread;
+          const Search::RootMove& rm = best->rootMoves[0];
+          bool tb = Tablebases::RootInTB && abs(rm.score) < VALUE_MATE - MAX_PLY;
+
+          out << " depth " << best->completedDepth / ONE_PLY
+              << " score " << UCI::value(tb ? rm.tbScore : rm.score)
+              << " nodes " << Threads.nodes_searched()
+              << " bestmove " << UCI::move(pos, rm.pv[0])
+              << " pv";
+          for (Move m : rm.pv)
+              out << " " << UCI::move(pos, m);
+
+          nodes += Threads.nodes_searched();
+      }
+
+      sync_cout << out.str() << sync_endl;
+      posCnt++;
+  }
+
+  elapsed = now() - elapsed + 1;
+
+  if (threadCnt != userThreads)
+      Options["Threads"] = std::to_string(userThreads);
+
+  sync_cout << "info string analyzed " << posCnt << " positions"
+            << " time " << elapsed
+            << " nodes " << nodes
+            << " nps " << 1000 * nodes / elapsed << sync_endl;
+}
@@ -19,6 +19,7 @@
 */
 
 #include <algorithm>
+#include <iostream>
 
 #include "bitboard.h"
 #include "misc.h"
@@ -43,13 +44,21 @@ Bitboard PseudoMoves[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
 Bitboard LeaperAttacks[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
 Bitboard LeaperMoves[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
 
+uint8_t AttackRiderTypes[PIECE_TYPE_NB];
+uint8_t MoveRiderTypes[PIECE_TYPE_NB];
+bool MovesEqualAttacks[PIECE_TYPE_NB];
+
+bool UsePext; // Whether pext or magics index the slider attacks, see fast_pext()
 Magic RookMagics[SQUARE_NB];
 Magic BishopMagics[SQUARE_NB];
 
 namespace {
 
 #ifdef LARGEBOARDS
-  Bitboard RookTable[0xA80000];  // To store rook attacks
+  // The rook attacks take 168 MB and are backed by huge pages where possible,
+  // which saves most of the page faults of filling them at startup.
+  constexpr size_t RookTableSize = 0xA80000;
+  Bitboard* RookTable;           // To store rook attacks
   Bitboard BishopTable[0x33C00]; // To store bishop attacks
 #else
   Bitboard RookTable[0x19000];  // To store rook attacks
@@ -305,13 +314,51 @@ namespace {
       B(0x1011002100821300, 0x2400825040804100)
   };
 #undef B
+#elif !defined(LARGEBOARDS) && defined(IS_64BIT)
+  // The magics found from the seeds in init_magics(), which saves their search
+  // at startup. The 32 bit index needs different magics.
+  Bitboard RookMagicInit[SQUARE_NB] = {
+      0xA80004000801220ULL, 0x8040004010002008ULL, 0x2080200010008008ULL, 0x1100100008210004ULL,
+      0xC200209084020008ULL, 0x2100010004000208ULL, 0x400081000822421ULL, 0x200010422048844ULL,
+      0x800800080400024ULL, 0x1402000401000ULL, 0x3000801000802001ULL, 0x4400800800100083ULL,
+      0x904802402480080ULL, 0x4040800400020080ULL, 0x18808042000100ULL, 0x4040800080004100ULL,
+      0x40048001458024ULL, 0xA0004000205000ULL, 0x3100808010002000ULL, 0x4825010010000820ULL,
+      0x5004808008000401ULL, 0x2024818004000A00ULL, 0x5808002000100ULL, 0x2100060004806104ULL,
+      0x80400880008421ULL, 0x4062220600410280ULL, 0x10A004A00108022ULL, 0x100080080080ULL,
+      0x21000500080010ULL, 0x44000202001008ULL, 0x100400080102ULL, 0xC020128200040545ULL,
+      0x80002000400040ULL, 0x804000802004ULL, 0x120022004080ULL, 0x10A386103001001ULL,
+      0x9010080080800400ULL, 0x8440020080800400ULL, 0x4228824001001ULL, 0x490A000084ULL,
+      0x80002000504000ULL, 0x200020005000C000ULL, 0x12088020420010ULL, 0x10010080080800ULL,
+      0x85001008010004ULL, 0x2000204008080ULL, 0x40413002040008ULL, 0x304081020004ULL,
+      0x80204000800080ULL, 0x3008804000290100ULL, 0x1010100080200080ULL, 0x2008100208028080ULL,
+      0x5000850800910100ULL, 0x8402019004680200ULL, 0x120911028020400ULL, 0x8044010200ULL,
+      0x20850200244012ULL, 0x20850200244012ULL, 0x102001040841ULL, 0x140900040A100021ULL,
+      0x200282410A102ULL, 0x200282410A102ULL, 0x200282410A102ULL, 0x4048240043802106ULL
+  };
+  Bitboard BishopMagicInit[SQUARE_NB] = {
+      0x40106000A1160020ULL, 0x20010250810120ULL, 0x2010010220280081ULL, 0x2806004050C040ULL,
+      0x2021018000000ULL, 0x2001112010000400ULL, 0x881010120218080ULL, 0x1030820110010500ULL,
+      0x120222042400ULL, 0x2000020404040044ULL, 0x8000480094208000ULL, 0x3422A02000001ULL,
+      0xA220210100040ULL, 0x8004820202226000ULL, 0x18234854100800ULL, 0x100004042101040ULL,
+      0x4001004082820ULL, 0x10000810010048ULL, 0x1014004208081300ULL, 0x2080818802044202ULL,
+      0x40880C00A00100ULL, 0x80400200522010ULL, 0x1000188180B04ULL, 0x80249202020204ULL,
+      0x1004400004100410ULL, 0x13100A0022206ULL, 0x2148500001040080ULL, 0x4241080011004300ULL,
+      0x4020848004002000ULL, 0x10101380D1004100ULL, 0x8004422020284ULL, 0x1010A1041008080ULL,
+      0x808080400082121ULL, 0x808080400082121ULL, 0x91128200100C00ULL, 0x202200802010104ULL,
+      0x8C0A020200440085ULL, 0x1A0008080B10040ULL, 0x889520080122800ULL, 0x100902022202010AULL,
+      0x4081A0816002000ULL, 0x681208005000ULL, 0x8170840041008802ULL, 0xA00004200810805ULL,
+      0x830404408210100ULL, 0x2602208106006102ULL, 0x1048300680802628ULL, 0x2602208106006102ULL,
+      0x602010120110040ULL, 0x941010801043000ULL, 0x40440A210428ULL, 0x8240020880021ULL,
+      0x400002012048200ULL, 0xAC102001210220ULL, 0x220021002009900ULL, 0x84440C080A013080ULL,
+      0x1008044200440ULL, 0x4C04410841000ULL, 0x2000500104011130ULL, 0x1A0C010011C20229ULL,
+      0x44800112202200ULL, 0x434804908100424ULL, 0x300404822C08200ULL, 0x48081010008A2A80ULL
+  };
+#else
+  Bitboard* RookMagicInit = nullptr;
+  Bitboard* BishopMagicInit = nullptr;
 #endif
 
-#ifdef PRECOMPUTED_MAGICS
   void init_magics(Bitboard table[], Magic magics[], Direction directions[], Bitboard magicsInit[]);
-#else
-  void init_magics(Bitboard table[], Magic magics[], Direction directions[]);
-#endif
 
   // popcount16() counts the non-zero bits using SWAR-Popcount algorithm
 
@@ -366,6 +413,8 @@ const std::string Bitboards::pretty(Bitboard b) {
 
 void Bitboards::init() {
 
+  UsePext = HasPext && fast_pext();
+
   for (unsigned i = 0; i < (1 << 16); ++i)
       PopCnt16[i] = (uint8_t) popcount16(i);
 
@@ -408,13 +457,20 @@ void Bitboards::init() {
   Direction RookDirections[5] = { NORTH,  EAST,  SOUTH,  WEST };
   Direction BishopDirections[5] = { NORTH_EAST, SOUTH_EAST, SOUTH_WEST, NORTH_WEST };
 
-#ifdef PRECOMPUTED_MAGICS
+#ifdef LARGEBOARDS
+  size_t rookTableSize = RookTableSize * sizeof(Bitboard);
+  std::string desc;
+  RookTable = static_cast<Bitboard*>(aligned_large_pages_alloc(rookTableSize, false, desc));
+
+  if (!RookTable)
+  {
+      std::cerr << "Failed to allocate the rook attacks table." << std::endl;
+      exit(EXIT_FAILURE);
+  }
+#endif
+
   init_magics(RookTable, RookMagics, RookDirections, RookMagicInit);
   init_magics(BishopTable, BishopMagics, BishopDirections, BishopMagicInit);
-#else
-  init_magics(RookTable, RookMagics, RookDirections);
-  init_magics(BishopTable, BishopMagics, BishopDirections);
-#endif
 
   int stepsCapture[][13] = {
       {}, // NO_PIECE_TYPE
@@ -609,6 +665,20 @@ void Bitboards::init() {
     0  // king
   };
 
+  // Diagonal slider directions are handled by bishop lookups, orthogonal ones
+  // by rook lookups. The steps are signed, so check absolute values.
+  auto rider_type = [](Direction d) {
+      return uint8_t(std::abs(d) == NORTH_EAST || std::abs(d) == NORTH_WEST ? RIDER_BISHOP : RIDER_ROOK);
+  };
+
+  for (PieceType pt = PAWN; pt <= KING; ++pt)
+  {
+      for (int i = 0; sliderCapture[pt][i]; ++i)
+          AttackRiderTypes[pt] |= rider_type(sliderCapture[pt][i]);
+      for (int i = 0; sliderQuiet[pt][i]; ++i)
+          MoveRiderTypes[pt] |= rider_type(sliderQuiet[pt][i]);
+  }
+
   for (Color c = WHITE; c <= BLACK; ++c)
       for (PieceType pt = PAWN; pt <= KING; ++pt)
           for (Square s = SQ_A1; s <= SQ_MAX; ++s)
@@ -637,6 +707,16 @@ void Bitboards::init() {
               PseudoMoves[c][pt][s] |= sliding_attack(sliderQuiet[pt], s, 0, sliderDistQuiet[pt], c);
           }
 
+  for (PieceType pt = PAWN; pt <= KING; ++pt)
+  {
+      MovesEqualAttacks[pt] = AttackRiderTypes[pt] == MoveRiderTypes[pt];
+      for (Color c = WHITE; c <= BLACK; ++c)
+          for (Square s = SQ_A1; s <= SQ_MAX; ++s)
+              if (   LeaperAttacks[c][pt][s] != LeaperMoves[c][pt][s]
+                  || PseudoAttacks[c][pt][s] != PseudoMoves[c][pt][s])
+                  MovesEqualAttacks[pt] = false;
+  }
+
   for (Square s1 = SQ_A1; s1 <= SQ_MAX; ++s1)
   {
       for (PieceType pt : { BISHOP, ROOK })
@@ -657,23 +737,18 @@ namespace {
   // init_magics() computes all rook and bishop attacks at startup. Magic
   // bitboards are used to look up attacks of sliding pieces. As a reference see
   // chessprogramming.wikispaces.com/Magic+Bitboards. In particular, here we
-  // use the so called "fancy" approach.
+  // use the so called "fancy" approach. The magics are searched for unless
+  // 'magicsInit' is given.
 
-#ifdef PRECOMPUTED_MAGICS
   void init_magics(Bitboard table[], Magic magics[], Direction directions[], Bitboard magicsInit[]) {
-#else
-  void init_magics(Bitboard table[], Magic magics[], Direction directions[]) {
-#endif
 
     // Optimal PRNG seeds to pick the correct magics in the shortest time
-#ifndef PRECOMPUTED_MAGICS
 #ifdef LARGEBOARDS
     int seeds[][RANK_NB] = { {},
                              {  734, 10316, 55013, 32803, 12281, 15100,  16645, 255, 346, 89123} };
 #else
     int seeds[][RANK_NB] = { { 8977, 44560, 54343, 38998,  5731, 95205, 104912, 17020 },
                              {  728, 10316, 55013, 32803, 12281, 15100,  16645,   255 } };
-#endif
 #endif
 
     Bitboard* occupancy = new Bitboard[1 << (FILE_NB + RANK_NB - 4)];
@@ -682,6 +757,27 @@ namespace {
     int* epoch = new int[1 << (FILE_NB + RANK_NB - 4)]();
     int cnt = 0, size = 0;
 
+    // The attacks of each subset are found from the nearest blocker on each ray
+    // instead of stepping through the squares with sliding_attack(), since this
+    // dominates the startup time with the large tables of large boards.
+    Bitboard rays[4][SQUARE_NB];
+
+    for (int i = 0; directions[i]; ++i)
+        for (Square s = SQ_A1; s <= SQ_MAX; ++s)
+        {
+            Direction ray[] = { directions[i], Direction(0) };
+            rays[i][s] = sliding_attack(ray, s, 0);
+        }
+
+    auto attacks = [&](Square s, Bitboard occupied) {
+        Bitboard attack = 0;
+        for (int i = 0; directions[i]; ++i)
+        {
+            Bitboard blockers = rays[i][s] & occupied;
+            attack |= rays[i][s] ^ (blockers ? rays[i][directions[i] > 0 ? lsb(blockers) : msb(blockers)] : 0);
+        }
+        return attack;
+    };
 
     for (Square s = SQ_A1; s <= SQ_MAX; ++s)
     {
@@ -696,7 +792,7 @@ namespace {
         Magic& m = magics[s];
         m.mask  = sliding_attack(directions, s, 0) & ~edges;
 #ifdef LARGEBOARDS
-        m.shift = 128 - popcount(m.mask);
+        m.shift = UsePext ? popcount(m.mask & ((Bitboard(1) << 64) - 1)) : 128 - popcount(m.mask);
 #else
         m.shift = (Is64Bit ? 64 : 32) - popcount(m.mask);
 #endif
@@ -710,21 +806,20 @@ namespace {
         b = size = 0;
         do {
             occupancy[size] = b;
-            reference[size] = sliding_attack(directions, s, b);
+            reference[size] = attacks(s, b);
 
-            if (HasPext)
-                m.attacks[pext(b, m.mask)] = reference[size];
+            if (UsePext)
+                m.attacks[m.index(b)] = reference[size];
 
             size++;
             b = (b - m.mask) & m.mask;
         } while (b);
 
-        if (HasPext)
+        if (UsePext)
             continue;
 
-#ifndef PRECOMPUTED_MAGICS
         PRNG rng(seeds[Is64Bit][rank_of(s)]);
-#endif
+        bool precomputed = magicsInit;
 
         // Find a magic for square 's' picking up an (almost) random number
         // until we find the one that passes the verification test.
@@ -732,14 +827,14 @@ namespace {
         {
             for (m.magic = 0; popcount(((m.magic * m.mask) & AllSquares) >> (SQUARE_NB - FILE_NB)) < FILE_NB - 2; )
             {
+                // A precomputed magic is tried only once, should it not fit
+                if (precomputed)
+                    m.magic = magicsInit[s], precomputed = false;
+                else
 #ifdef LARGEBOARDS
-#ifdef PRECOMPUTED_MAGICS
-                m.magic = magicsInit[s];
-#else
-                m.magic = (rng.sparse_rand<Bitboard>() << 64) ^ rng.sparse_rand<Bitboard>();
-#endif
+                    m.magic = (rng.sparse_rand<Bitboard>() << 64) ^ rng.sparse_rand<Bitboard>();
 #else
-                m.magic = rng.sparse_rand<Bitboard>();
+                    m.magic = rng.sparse_rand<Bitboard>();
 #endif
             }
 
@@ -106,10 +106,22 @@ extern Bitboard PseudoMoves[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
 extern Bitboard LeaperAttacks[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
 extern Bitboard LeaperMoves[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
 
+/// RiderType tells which slider lookups are needed for the sliding component
+/// of a piece type, so that pure leapers do not need any slider lookup at all.
+enum RiderType : uint8_t {
+  NO_RIDER = 0, RIDER_BISHOP = 1, RIDER_ROOK = 2
+};
+
+extern uint8_t AttackRiderTypes[PIECE_TYPE_NB];
+extern uint8_t MoveRiderTypes[PIECE_TYPE_NB];
+extern bool MovesEqualAttacks[PIECE_TYPE_NB]; // Quiet moves and captures are the same
+
 #ifdef LARGEBOARDS
 int popcount(Bitboard b); // required for 128 bit pext
 #endif
 
+extern bool UsePext;
+
 /// Magic holds all magic bitboards relevant data for a single square
 struct Magic {
   Bitboard  mask;
@@ -120,7 +132,14 @@ struct Magic {
   // Compute the attack's index using the 'magic bitboards' approach
   unsigned index(Bitboard occupied) const {
 
-    if (HasPext)
+#if defined(LARGEBOARDS) && defined(USE_PEXT)
+    // For 128 bit boards the shift holds the number of mask bits in the lower
+    // half, so that we do not need to recompute it on each lookup.
+    if (UsePext)
+        return unsigned(_pext_u64(occupied, mask) ^ (_pext_u64(occupied >> 64, mask >> 64) << shift));
+#endif
+
+    if (HasPext && UsePext)
         return unsigned(pext(occupied, mask));
 
     if (Is64Bit)
@@ -348,12 +367,27 @@ inline Bitboard attacks_bb(Square s, Bitboard occupied) {
   return m.attacks[m.index(occupied)];
 }
 
+/// rider_attacks_bb() returns the squares reached by the sliding component of
+/// a piece, given its rider types and its attacks or moves on an empty board.
+
+inline Bitboard rider_attacks_bb(uint8_t riders, Bitboard pseudo, Square s, Bitboard occupied) {
+
+  Bitboard b = 0;
+  if (riders & RIDER_BISHOP)
+      b |= attacks_bb<BISHOP>(s, occupied);
+  if (riders & RIDER_ROOK)
+      b |= attacks_bb<ROOK>(s, occupied);
+  return pseudo & b;
+}
+
 inline Bitboard attacks_bb(Color c, PieceType pt, Square s, Bitboard occupied) {
-  return LeaperAttacks[c][pt][s] | (PseudoAttacks[c][pt][s] & (attacks_bb<BISHOP>(s, occupied) | attacks_bb<ROOK>(s, occupied)));
+  return  LeaperAttacks[c][pt][s]
+        | (AttackRiderTypes[pt] ? rider_attacks_bb(AttackRiderTypes[pt], PseudoAttacks[c][pt][s], s, occupied) : 0);
 }
 
 inline Bitboard moves_bb(Color c, PieceType pt, Square s, Bitboard occupied) {
-  return LeaperMoves[c][pt][s] | (PseudoMoves[c][pt][s] & (attacks_bb<BISHOP>(s, occupied) | attacks_bb<ROOK>(s, occupied)));
+  return  LeaperMoves[c][pt][s]
+        | (MoveRiderTypes[pt] ? rider_attacks_bb(MoveRiderTypes[pt], PseudoMoves[c][pt][s], s, occupied) : 0);
 }
 
 
@@ -406,9 +440,11 @@ inline Square msb(Bitboard b) {
   assert(b);
 #ifdef LARGEBOARDS
   if (b >> 64)
-      return Square(SQUARE_BIT_MASK ^ (__builtin_clzll(b >> 64) + 64));
-#endif
+      return Square(SQUARE_BIT_MASK ^ __builtin_clzll(b >> 64));
+  return Square(SQUARE_BIT_MASK ^ (__builtin_clzll(b) + 64));
+#else
   return Square(SQUARE_BIT_MASK ^ __builtin_clzll(b));
+#endif
 }
 
 #elif defined(_MSC_VER)  // MSVC
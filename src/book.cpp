@@ -0,0 +1,265 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>   // For std::memcmp
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+
+#include "book.h"
+#include "uci.h"
+#include "variant.h"
+
+OpeningBook Book; // Our global opening book
+
+namespace {
+
+  // Header of the book file format. The entries follow at a page aligned offset,
+  // so that they can be mapped directly into memory, like a saved hash file.
+  constexpr char FileMagic[8] = { 'F', 'S', 'F', 'B', 'O', 'O', 'K', '\0' };
+  constexpr uint32_t FileVersion = 1;
+  constexpr size_t HeaderSize = 4096;
+
+  struct FileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t squareNb;
+    uint64_t entryCount;
+    char     variant[64];
+  };
+
+  static_assert(sizeof(FileHeader) <= HeaderSize, "File header too large");
+
+} // namespace
+
+
+/// OpeningBook::clear() releases the book, it is loaded again at the next probe
+
+void OpeningBook::clear() {
+
+  if (mem)
+      aligned_large_pages_free(mem, memSize);
+  mem = nullptr;
+  entries = nullptr;
+  entryCount = memSize = 0;
+  data.clear();
+  variant.clear();
+}
+
+
+std::string OpeningBook::file_name(const std::string& var) const {
+
+  std::string path = Options["Book Path"];
+  return path.empty() || path == "<empty>" ? "" : path + "/" + var + ".bin";
+}
+
+
+/// OpeningBook::load() replaces the book by the one of the given variant. If the
+/// variant has no book, the book is empty until the variant changes.
+
+bool OpeningBook::load(const std::string& var) {
+
+  clear();
+  variant = var;
+
+  FileHeader header = {};
+  std::string fname = file_name(var), error;
+  std::ifstream file(fname, std::ios::binary | std::ios::ate);
+  size_t fileSize = file ? size_t(file.tellg()) : 0;
+
+  if (!file)
+      return false;
+
+  file.seekg(0);
+  file.read((char*)&header, sizeof(FileHeader));
+  header.variant[sizeof(header.variant) - 1] = '\0';
+
+  if (!file || std::memcmp(header.magic, FileMagic, sizeof(FileMagic)))
+      error = "not a book file";
+  else if (header.version != FileVersion)
+      error = "incompatible file version";
+  else if (header.squareNb != SQUARE_NB)
+      error = "made by a build for a different board size";
+  else if (var != header.variant)
+      error = "made for variant " + std::string(header.variant);
+  else if (   fileSize < HeaderSize
+           || header.entryCount > (fileSize - HeaderSize) / sizeof(BookEntry) // No overflow below
+           || fileSize != HeaderSize + header.entryCount * sizeof(BookEntry))
+      error = "truncated file";
+
+  if (!error.empty())
+  {
+      sync_cout << "info string Book file " << fname << " rejected: " << error << sync_endl;
+      return false;
+  }
+
+  entryCount = header.entryCount;
+  memSize = entryCount * sizeof(BookEntry);
+  mem = entryCount ? map_file(fname, HeaderSize, memSize) : nullptr;
+
+  if (mem)
+      entries = static_cast<const BookEntry*>(mem);
+  else
+  {
+      data.resize(entryCount);
+      file.seekg(HeaderSize);
+      file.read((char*)data.data(), memSize);
+      entries = data.data();
+  }
+
+  sync_cout << "info string Book " << fname << " with " << entryCount << " entries "
+            << (mem ? "mapped" : "read") << sync_endl;
+  return true;
+}
+
+
+/// OpeningBook::probe() returns a book move for the given position, or MOVE_NONE.
+/// Moves are picked at random according to their weights, or the move with the
+/// highest weight if 'bestMove' is set.
+
+Move OpeningBook::probe(const Position& pos, bool bestMove) {
+
+  std::string var = Options["UCI_Variant"];
+
+  if (var != variant)
+      load(var);
+
+  auto cmp = [](const BookEntry& e, Key k) { return e.key < k; };
+  const BookEntry* first = std::lower_bound(entries, entries + entryCount, pos.key(), cmp);
+  const BookEntry* last = first;
+  uint64_t sum = 0;
+
+  for ( ; last < entries + entryCount && last->key == pos.key(); ++last)
+      sum += last->weight;
+
+  if (first == last)
+      return MOVE_NONE;
+
+  // Entries of a position are sorted by decreasing weight
+  if (bestMove || !sum)
+      return Move(first->move);
+
+  uint64_t r = rng.rand<uint64_t>() % sum;
+  for (const BookEntry* e = first; e < last; ++e)
+      if (r < e->weight)
+          return Move(e->move);
+      else
+          r -= e->weight;
+
+  return Move(first->move);
+}
+
+
+/// OpeningBook::make() builds the book of the current variant from a file of
+/// games, one per line, each given like the arguments of the "position" command,
+/// e.g. "startpos moves e2e4 e7e5" or just "e2e4 e7e5". The weight of a move is
+/// the number of games it was played in, in the first 'plies' plies.
+///
+/// makebook <games file> [plies 20]
+
+bool OpeningBook::make(const Position& pos, std::istream& is) {
+
+  std::string gamesFile, token, var = Options["UCI_Variant"];
+  std::string fname = file_name(var);
+  const Variant* v = variants.find(var)->second; // Not necessarily the one of pos
+  int plies = 20;
+
+  is >> gamesFile;
+  while (is >> token)
+      if (token == "plies")
+          is >> plies;
+
+  std::ifstream games(gamesFile);
+
+  if (fname.empty() || !games)
+  {
+      sync_cout << "info string " << (fname.empty() ? "Book Path is not set" : "Cannot read " + gamesFile) << sync_endl;
+      return false;
+  }
+
+  std::map<std::pair<Key, Move>, uint64_t> counts;
+  std::string line;
+  size_t gameCnt = 0;
+
+  while (std::getline(games, line))
+  {
+      std::istringstream ss(line);
+      std::string fen = v->startFen;
+      Position p;
+      std::unique_ptr<std::deque<StateInfo>> states(new std::deque<StateInfo>(1));
+
+      if (!(ss >> token))
+          continue;
+
+      if (token == "fen")
+          for (fen.clear(); ss >> token && token != "moves"; )
+              fen += token + " ";
+      else if (token == "startpos")
+          ss >> token; // Consume "moves" if any
+      else
+          ss.clear(), ss.seekg(0);
+
+      p.set(v, fen, Options["UCI_Chess960"], &states->back(), pos.this_thread());
+
+      for (int ply = 0; ply < plies && ss >> token; ++ply)
+      {
+          Move m = UCI::to_move(p, token);
+          if (m == MOVE_NONE)
+              break;
+
+          counts[std::make_pair(p.key(), m)]++;
+          states->emplace_back();
+          p.do_move(m, states->back());
+      }
+      gameCnt++;
+  }
+
+  std::vector<BookEntry> newEntries;
+  for (const auto& c : counts)
+      newEntries.push_back({ c.first.first, uint32_t(c.first.second),
+                             uint16_t(std::min(c.second, uint64_t(0xFFFF))), 0 });
+
+  std::sort(newEntries.begin(), newEntries.end(), [](const BookEntry& a, const BookEntry& b) {
+      return a.key != b.key ? a.key < b.key : a.weight > b.weight;
+  });
+
+  FileHeader header = {};
+  std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+  header.version = FileVersion;
+  header.squareNb = SQUARE_NB;
+  header.entryCount = newEntries.size();
+  var.copy(header.variant, sizeof(header.variant) - 1);
+
+  clear(); // The file may be mapped
+
+  std::ofstream file(fname, std::ios::binary);
+  std::vector<char> padding(HeaderSize - sizeof(FileHeader));
+  file.write((const char*)&header, sizeof(FileHeader));
+  file.write(padding.data(), padding.size());
+  file.write((const char*)newEntries.data(), newEntries.size() * sizeof(BookEntry));
+
+  sync_cout << "info string Book " << (file ? "made with " : "could not be written with ")
+            << gameCnt << " games and " << newEntries.size() << " entries to " << fname << sync_endl;
+  return bool(file);
+}
@@ -0,0 +1,75 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BOOK_H_INCLUDED
+#define BOOK_H_INCLUDED
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "misc.h"
+#include "position.h"
+#include "types.h"
+
+/// BookEntry is a 16 bytes opening book entry. Like in the Polyglot format the
+/// entries are sorted by key, but the key is the Zobrist key of the position, so
+/// that it covers the pieces in hand and the checks given, and the move is stored
+/// in the encoding of the engine. Both depend on the board size of the build.
+
+struct BookEntry {
+  uint64_t key;
+  uint32_t move;
+  uint16_t weight;
+  uint16_t learn;
+};
+
+static_assert(sizeof(BookEntry) == 16, "Unexpected BookEntry size");
+
+
+/// OpeningBook holds the book of one variant at a time. The book of a variant is
+/// the file "<variant>.bin" in the directory given by the "Book Path" option. It
+/// is mapped into memory when a position of the variant is probed for the first
+/// time, and replaced when the variant changes.
+
+class OpeningBook {
+
+public:
+ ~OpeningBook() { clear(); }
+  void clear();
+  Move probe(const Position& pos, bool bestMove);
+  bool make(const Position& pos, std::istream& is);
+
+private:
+  bool load(const std::string& variant);
+  std::string file_name(const std::string& variant) const;
+
+  std::string variant;
+  const BookEntry* entries = nullptr;
+  size_t entryCount = 0;
+  void* mem = nullptr;
+  size_t memSize = 0;
+  std::vector<BookEntry> data; // Used where the file cannot be mapped
+  PRNG rng = PRNG(now());
+};
+
+extern OpeningBook Book;
+
+#endif // #ifndef BOOK_H_INCLUDED
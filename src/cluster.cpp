@@ -0,0 +1,338 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef USE_MPI
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <mpi.h>
+#include <vector>
+
+#include "cluster.h"
+#include "thread.h"
+#include "tt.h"
+
+namespace Cluster {
+
+namespace {
+
+  // Only entries of at least this depth are shared with the other ranks
+  constexpr Depth TTShareDepth = 8 * ONE_PLY;
+
+  // Maximum number of entries a rank sends in one exchange round. Deep
+  // entries saved while the previous round is still in flight are dropped
+  // once the buffer is full.
+  constexpr size_t TTBatchSize = 256;
+
+  struct KeyedTTEntry {
+    Key key;
+    TTEntry entry;
+  };
+
+  // Values summed over all ranks in every signals round
+  enum Signal { SIG_STOP, SIG_NODES, SIG_TB, SIG_NB };
+
+  int worldRank, worldSize;
+
+  // Separate communicators, so that the collectives of the input thread, the
+  // search signals, the TT exchange and the move selection never interleave.
+  MPI_Comm InputComm, SignalsComm, TTComm, MoveComm;
+
+  MPI_Request signalsRequest = MPI_REQUEST_NULL;
+  uint64_t signalsSend[SIG_NB], signalsRecv[SIG_NB];
+  uint64_t nodesOthers, tbHitsOthers;
+
+  MPI_Request ttRequest = MPI_REQUEST_NULL;
+  uint64_t ttRounds;
+  Mutex ttMutex;
+  std::vector<KeyedTTEntry> ttBuffer, ttSendBuffer, ttRecvBuffer;
+
+  // post_signals() starts a new round of signals with our current state
+
+  void post_signals(bool stop) {
+
+    signalsSend[SIG_STOP] = stop;
+    signalsSend[SIG_NODES] = Threads.nodes_searched();
+    signalsSend[SIG_TB] = Threads.tb_hits();
+    MPI_Iallreduce(signalsSend, signalsRecv, SIG_NB, MPI_UINT64_T, MPI_SUM,
+                   SignalsComm, &signalsRequest);
+  }
+
+  // read_signals() updates the counters of the other ranks after a round
+
+  void read_signals() {
+
+    nodesOthers = signalsRecv[SIG_NODES] - signalsSend[SIG_NODES];
+    tbHitsOthers = signalsRecv[SIG_TB] - signalsSend[SIG_TB];
+  }
+
+  // post_tt_round() sends the entries collected since the last round. The
+  // buffers have a fixed size, unused slots are marked by BOUND_NONE.
+
+  void post_tt_round() {
+
+    {
+        std::unique_lock<Mutex> lk(ttMutex);
+        std::copy(ttBuffer.begin(), ttBuffer.end(), ttSendBuffer.begin());
+        std::fill(ttSendBuffer.begin() + ttBuffer.size(), ttSendBuffer.end(), KeyedTTEntry());
+        ttBuffer.clear();
+    }
+
+    MPI_Iallgather(ttSendBuffer.data(), TTBatchSize * sizeof(KeyedTTEntry), MPI_BYTE,
+                   ttRecvBuffer.data(), TTBatchSize * sizeof(KeyedTTEntry), MPI_BYTE,
+                   TTComm, &ttRequest);
+    ++ttRounds;
+  }
+
+  // insert_tt_round() stores the entries received from the other ranks in
+  // the last completed round into our transposition table.
+
+  void insert_tt_round() {
+
+    for (int r = 0; r < worldSize; ++r)
+    {
+        if (r == worldRank)
+            continue;
+
+        for (size_t i = 0; i < TTBatchSize; ++i)
+        {
+            const KeyedTTEntry& e = ttRecvBuffer[r * TTBatchSize + i];
+            if (e.entry.bound() == BOUND_NONE)
+                break;
+
+            bool found;
+            TTEntry* tte = TT.probe(e.key, found);
+            tte->save(e.key, e.entry.value(), e.entry.bound(), e.entry.depth(),
+                      e.entry.move(), e.entry.eval(), TT.generation());
+        }
+    }
+
+    std::fill(ttRecvBuffer.begin(), ttRecvBuffer.end(), KeyedTTEntry());
+  }
+
+} // namespace
+
+
+/// init() initializes MPI. All ranks but the root have their output silenced,
+/// so only one process talks to the GUI.
+
+void init() {
+
+  int provided;
+  MPI_Init_thread(nullptr, nullptr, MPI_THREAD_MULTIPLE, &provided);
+
+  if (provided < MPI_THREAD_MULTIPLE)
+  {
+      std::cerr << "MPI implementation does not support MPI_THREAD_MULTIPLE." << std::endl;
+      MPI_Finalize();
+      exit(EXIT_FAILURE);
+  }
+
+  MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
+  MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
+
+  MPI_Comm_dup(MPI_COMM_WORLD, &InputComm);
+  MPI_Comm_dup(MPI_COMM_WORLD, &SignalsComm);
+  MPI_Comm_dup(MPI_COMM_WORLD, &TTComm);
+  MPI_Comm_dup(MPI_COMM_WORLD, &MoveComm);
+
+  ttBuffer.reserve(TTBatchSize);
+  ttSendBuffer.resize(TTBatchSize);
+  ttRecvBuffer.resize(TTBatchSize * worldSize);
+
+  if (!is_root())
+      std::cout.rdbuf(nullptr);
+}
+
+
+/// finalize() shuts down MPI before exiting
+
+void finalize() {
+
+  MPI_Comm_free(&InputComm);
+  MPI_Comm_free(&SignalsComm);
+  MPI_Comm_free(&TTComm);
+  MPI_Comm_free(&MoveComm);
+  MPI_Finalize();
+}
+
+
+int rank() { return worldRank; }
+
+int size() { return worldSize; }
+
+
+/// getline() reads a line on the root rank and broadcasts it to all others,
+/// so that every rank executes the same sequence of commands.
+
+bool getline(std::istream& input, std::string& str) {
+
+  int msg[2] = { 0, 0 }; // Read state and length of the line
+
+  if (is_root())
+  {
+      msg[0] = bool(std::getline(input, str));
+      msg[1] = int(str.size());
+  }
+
+  MPI_Bcast(msg, 2, MPI_INT, 0, InputComm);
+
+  if (!is_root())
+      str.resize(msg[1]);
+
+  MPI_Bcast(&str[0], msg[1], MPI_CHAR, 0, InputComm);
+
+  return msg[0];
+}
+
+
+/// save() stores an entry in the local transposition table and queues deep
+/// entries to be sent to the other ranks in the next exchange round.
+
+void save(TTEntry* tte, Key k, Value v, Bound b, Depth d, Move m, Value ev) {
+
+  tte->save(k, v, b, d, m, ev, TT.generation());
+
+  if (d >= TTShareDepth && b != BOUND_NONE)
+  {
+      std::unique_lock<Mutex> lk(ttMutex);
+
+      if (ttBuffer.size() < TTBatchSize)
+      {
+          KeyedTTEntry e = KeyedTTEntry();
+          e.key = k;
+          e.entry.save(k, v, b, d, m, ev, TT.generation());
+          ttBuffer.push_back(e);
+      }
+  }
+}
+
+
+/// sync_start() is called by the main thread of every rank at the start of
+/// a search and opens the first round of signals.
+
+void sync_start() {
+
+  nodesOthers = tbHitsOthers = 0;
+  ttRounds = 0;
+  post_signals(false);
+}
+
+
+/// signals_poll() is called periodically by the main thread during the search.
+/// It completes pending rounds without blocking, raises the stop flag if any
+/// rank has stopped, and starts the next rounds of signals and TT entries.
+
+void signals_poll() {
+
+  int flag;
+
+  MPI_Test(&signalsRequest, &flag, MPI_STATUS_IGNORE);
+  if (flag)
+  {
+      read_signals();
+      if (signalsRecv[SIG_STOP])
+          Threads.stop = true;
+
+      post_signals(Threads.stop);
+  }
+
+  MPI_Test(&ttRequest, &flag, MPI_STATUS_IGNORE);
+  if (flag)
+  {
+      insert_tt_round();
+      post_tt_round();
+  }
+}
+
+
+/// sync_stop() is called by the main thread after its own threads have been
+/// stopped. It waits until all ranks have stopped and then completes the TT
+/// exchange, so that all collectives are matched before the next search.
+
+void sync_stop() {
+
+  while (true)
+  {
+      MPI_Wait(&signalsRequest, MPI_STATUS_IGNORE);
+      read_signals();
+
+      if (signalsRecv[SIG_STOP] == uint64_t(worldSize))
+          break;
+
+      post_signals(true);
+  }
+
+  // A rank starts a new TT round only when the previous one has completed on
+  // all ranks, so the round counts differ by at most one here.
+  uint64_t maxRounds;
+  MPI_Allreduce(&ttRounds, &maxRounds, 1, MPI_UINT64_T, MPI_MAX, SignalsComm);
+
+  MPI_Wait(&ttRequest, MPI_STATUS_IGNORE);
+  insert_tt_round();
+
+  if (ttRounds < maxRounds)
+  {
+      post_tt_round();
+      MPI_Wait(&ttRequest, MPI_STATUS_IGNORE);
+      insert_tt_round();
+  }
+}
+
+
+/// pick_moves() exchanges the results of all ranks. If selectBest is set, the
+/// best of them is chosen in the same way as among the threads of one rank,
+/// otherwise the result of the root rank is used.
+
+void pick_moves(MoveInfo& mi, bool selectBest) {
+
+  std::vector<MoveInfo> results(worldSize);
+
+  mi.rank = worldRank;
+  MPI_Allgather(&mi, sizeof(MoveInfo), MPI_BYTE,
+                results.data(), sizeof(MoveInfo), MPI_BYTE, MoveComm);
+
+  size_t best = 0;
+  if (selectBest)
+      for (size_t i = 1; i < results.size(); ++i)
+      {
+          int depthDiff = results[i].depth - results[best].depth;
+          int scoreDiff = results[i].score - results[best].score;
+
+          if (    scoreDiff > 0
+              && (depthDiff >= 0 || results[i].score >= VALUE_MATE_IN_MAX_PLY))
+              best = i;
+      }
+
+  mi = results[best];
+}
+
+
+/// nodes_searched() and tb_hits() return the counters of all ranks, as known
+/// after the last completed signals round.
+
+uint64_t nodes_searched() { return nodesOthers + Threads.nodes_searched(); }
+
+uint64_t tb_hits() { return tbHitsOthers + Threads.tb_hits(); }
+
+} // namespace Cluster
+
+#endif // USE_MPI
@@ -0,0 +1,90 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLUSTER_H_INCLUDED
+#define CLUSTER_H_INCLUDED
+
+#include <istream>
+#include <string>
+
+#include "thread.h"
+#include "tt.h"
+
+/// The Cluster namespace distributes a search over several processes, e.g. on
+/// different machines, using MPI. Every process (rank) runs a normal Lazy SMP
+/// search on the same root position. Deep transposition table writes are
+/// exchanged asynchronously in batches, and the root rank, which is the only
+/// one talking to the GUI, combines the node counts and picks the best move
+/// found by all ranks. Without USE_MPI all functions reduce to the single
+/// node behaviour.
+
+namespace Cluster {
+
+/// MoveInfo is the result of the search of one rank, as exchanged at the end
+/// of a search to select the move to play.
+
+struct MoveInfo {
+  int depth;
+  int selDepth;
+  int score;
+  int rank;
+  int pvLength;
+  Move pv[MAX_PLY];
+};
+
+#ifdef USE_MPI
+
+void init();
+void finalize();
+bool getline(std::istream& input, std::string& str);
+int size();
+int rank();
+inline bool is_root() { return rank() == 0; }
+void save(TTEntry* tte, Key k, Value v, Bound b, Depth d, Move m, Value ev);
+void pick_moves(MoveInfo& mi, bool selectBest);
+void sync_start();
+void sync_stop();
+void signals_poll();
+uint64_t nodes_searched();
+uint64_t tb_hits();
+
+#else
+
+inline void init() { }
+inline void finalize() { }
+inline bool getline(std::istream& input, std::string& str) { return bool(std::getline(input, str)); }
+constexpr int size() { return 1; }
+constexpr int rank() { return 0; }
+constexpr bool is_root() { return true; }
+inline void save(TTEntry* tte, Key k, Value v, Bound b, Depth d, Move m, Value ev) {
+  tte->save(k, v, b, d, m, ev, TT.generation());
+}
+inline void pick_moves(MoveInfo&, bool) { }
+inline void sync_start() { }
+inline void sync_stop() { }
+inline void signals_poll() { }
+inline uint64_t nodes_searched() { return Threads.nodes_searched(); }
+inline uint64_t tb_hits() { return Threads.tb_hits(); }
+
+#endif
+
+} // namespace Cluster
+
+#endif // #ifndef CLUSTER_H_INCLUDED
@@ -27,6 +27,7 @@
 #include "bitboard.h"
 #include "evaluate.h"
 #include "material.h"
+#include "nnue.h"
 #include "pawns.h"
 #include "thread.h"
 
@@ -311,6 +312,7 @@ namespace {
     constexpr Bitboard OutpostRanks = (Us == WHITE ? Rank4BB | Rank5BB | Rank6BB
                                                    : Rank5BB | Rank4BB | Rank3BB);
     const Square* pl = pos.squares(Us, Pt);
+    const bool symmetric = MovesEqualAttacks[Pt];
 
     Bitboard b, bb;
     Square s;
@@ -323,6 +325,7 @@ namespace {
         // Find attacked squares, including x-ray attacks for bishops and rooks
         b = Pt == BISHOP ? attacks_bb<BISHOP>(s, pos.pieces() ^ pos.pieces(QUEEN))
           : Pt ==   ROOK ? attacks_bb<  ROOK>(s, pos.pieces() ^ pos.pieces(QUEEN) ^ pos.pieces(Us, ROOK))
+          : symmetric    ? pos.attacks_from(Us, Pt, s)
                          : (  (pos.attacks_from(Us, Pt, s) & pos.pieces())
                             | (pos.moves_from(Us, Pt, s) & ~pos.pieces()));
 
@@ -1057,12 +1060,16 @@ namespace {
     // Pieces should be evaluated first (populate attack tables).
     // For unused piece types, we still need to set attack bitboard to zero.
     for (PieceType pt = KNIGHT; pt < KING; ++pt)
-        score += pieces<WHITE>(pt) - pieces<BLACK>(pt);
+        if (pos.pieces(pt))
+            score += pieces<WHITE>(pt) - pieces<BLACK>(pt);
+        else
+            attackedBy[WHITE][pt] = attackedBy[BLACK][pt] = 0;
 
     // Evaluate pieces in hand once attack tables are complete
     if (pos.piece_drops())
         for (PieceType pt = PAWN; pt < KING; ++pt)
-            score += hand<WHITE>(pt) - hand<BLACK>(pt);
+            if (pos.count_in_hand(WHITE, pt) || pos.count_in_hand(BLACK, pt))
+                score += hand<WHITE>(pt) - hand<BLACK>(pt);
 
     score += (mobility[WHITE] - mobility[BLACK]) * (1 + pos.captures_to_hand() + pos.must_capture());
 
@@ -1105,9 +1112,14 @@ Value Eval::tempo_value(const Position& pos) {
 
 
 /// evaluate() is the evaluator for the outer world. It returns a static
-/// evaluation of the position from the point of view of the side to move.
+/// evaluation of the position from the point of view of the side to move,
+/// by the network of the variant if there is one.
 
 Value Eval::evaluate(const Position& pos) {
+
+  if (NNUE::enabled(pos))
+      return NNUE::evaluate(pos) + Eval::tempo_value(pos);
+
   return Evaluation<NO_TRACE>(pos).value();
 }
 
@@ -1150,5 +1162,13 @@ std::string Eval::trace(const Position& pos) {
 
   ss << "\nTotal evaluation: " << to_cp(v) << " (white side)\n";
 
+  if (NNUE::enabled(pos))
+  {
+      NNUE::refresh(pos); // The state may have been evaluated by another network
+      v = NNUE::evaluate(pos) + Eval::tempo_value(pos);
+      v = pos.side_to_move() == WHITE ? v : -v;
+      ss << "NNUE evaluation: " << to_cp(v) << " (white side)\n";
+  }
+
   return ss.str();
 }
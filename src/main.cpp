@@ -21,6 +21,7 @@
 #include <iostream>
 
 #include "bitboard.h"
+#include "cluster.h"
 #include "position.h"
 #include "search.h"
 #include "thread.h"
@@ -29,19 +30,16 @@
 #include "variant.h"
 #include "syzygy/tbprobe.h"
 
-namespace PSQT {
-  void init(const Variant* v);
-}
-
 int main(int argc, char* argv[]) {
 
+  Cluster::init();
+
   std::cout << engine_info() << std::endl;
 
-  variants.init();
-  UCI::init(Options);
-  PSQT::init(variants.find("chess")->second);
   Bitboards::init();
   Position::init();
+  variants.init(); // After Zobrist keys are set
+  UCI::init(Options);
   Bitbases::init();
   Search::init();
   Pawns::init();
@@ -53,5 +51,6 @@ int main(int argc, char* argv[]) {
 
   Threads.set(0);
   variants.clear_all();
+  Cluster::finalize();
   return 0;
 }
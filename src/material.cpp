@@ -113,18 +113,15 @@ namespace {
 
 namespace Material {
 
-/// Material::probe() looks up the current position's material configuration in
-/// the material hash table. It returns a pointer to the Entry if the position
-/// is found. Otherwise a new Entry is computed and stored there, so we don't
-/// have to recompute all when the same material configuration occurs again.
+SharedTable Shared; // Shared by all threads, empty unless enabled
 
-Entry* probe(const Position& pos) {
+namespace {
 
-  Key key = pos.material_key();
-  Entry* e = pos.this_thread()->materialTable[key];
+// compute() fills an entry for the position's material configuration. Endgame
+// functions of the entry belong to the calling thread, but are valid for all
+// threads, so entries can be shared as long as the threads exist.
 
-  if (e->key == key)
-      return e;
+void compute(const Position& pos, Entry* e, Key key) {
 
   std::memset(e, 0, sizeof(Entry));
   e->key = key;
@@ -156,13 +153,13 @@ Entry* probe(const Position& pos) {
       // material configuration. Firstly we look for a fixed configuration one, then
       // for a generic one if the previous search failed.
       if ((e->evaluationFunction = pos.this_thread()->endgames.probe<Value>(key)) != nullptr)
-          return e;
+          return;
 
       for (Color c = WHITE; c <= BLACK; ++c)
           if (is_KXK(pos, c))
           {
               e->evaluationFunction = &EvaluateKXK[c];
-              return e;
+              return;
           }
 
       // OK, we didn't find any special evaluation function for the current material
@@ -172,7 +169,7 @@ Entry* probe(const Position& pos) {
       if ((sf = pos.this_thread()->endgames.probe<ScaleFactor>(key)) != nullptr)
       {
           e->scalingFunction[sf->strongSide] = sf; // Only strong color assigned
-          return e;
+          return;
       }
 
       // We didn't find any specialized scaling function, so fall back on generic
@@ -232,6 +229,37 @@ Entry* probe(const Position& pos) {
     pos.count<BISHOP>(BLACK)    , pos.count<ROOK>(BLACK), pos.count<QUEEN >(BLACK) } };
 
   e->value = int16_t((imbalance<WHITE>(pieceCount) - imbalance<BLACK>(pieceCount)) / 16);
+}
+
+} // namespace
+
+
+/// Material::probe() looks up the current position's material configuration in
+/// the material hash table. It returns a pointer to the Entry if the position
+/// is found. Otherwise a new Entry is computed and stored there, so we don't
+/// have to recompute all when the same material configuration occurs again.
+
+Entry* probe(const Position& pos) {
+
+  Key key = pos.material_key();
+  Table& table = pos.this_thread()->materialTable;
+  Entry* e = table[key];
+
+  if (e->key == key)
+  {
+      table.hits++;
+      return e;
+  }
+
+  if (Shared.probe(key, *e))
+      table.sharedHits++;
+  else
+  {
+      table.misses++;
+      compute(pos, e, key);
+      Shared.store(*e);
+  }
+
   return e;
 }
 
@@ -65,6 +65,9 @@ struct Entry {
 };
 
 typedef HashTable<Entry, 8192> Table;
+typedef SharedHashTable<Entry> SharedTable;
+
+extern SharedTable Shared;
 
 Entry* probe(const Position& pos);
 
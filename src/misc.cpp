@@ -41,12 +41,29 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 }
 #endif
 
+#include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <vector>
 
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(USE_PEXT)
+#  if defined(_MSC_VER)
+#    include <intrin.h> // For __cpuid()
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
 #include "misc.h"
 #include "thread.h"
 
@@ -216,9 +233,332 @@ void prefetch2(void* addr) {
   prefetch((uint8_t*)addr + 64);
 }
 
+/// fast_pext() tells whether the pext instruction is available and executed in
+/// hardware. AMD processors before Zen 3 (family 19h) implement it in microcode,
+/// slow enough that magic bitboards are faster for the slider attacks.
+
+bool fast_pext() {
+
+#if defined(USE_PEXT)
+  int regs[4] = {};
+#  if defined(_MSC_VER)
+  __cpuid(regs, 0);
+  bool amd = regs[1] == 0x68747541; // "AuthenticAMD"
+  __cpuid(regs, 1);
+#  else
+  unsigned* r = reinterpret_cast<unsigned*>(regs);
+  __get_cpuid(0, &r[0], &r[1], &r[2], &r[3]);
+  bool amd = r[1] == 0x68747541; // "AuthenticAMD"
+  __get_cpuid(1, &r[0], &r[1], &r[2], &r[3]);
+#  endif
+  int family = (regs[0] >> 8) & 0xF;
+  if (family == 0xF)
+      family += (regs[0] >> 20) & 0xFF;
+
+  return !amd || family >= 0x19;
+#else
+  return false;
+#endif
+}
+
+/// aligned_large_pages_alloc() allocates memory for large, frequently accessed
+/// tables like the transposition table. It tries to back the memory by huge
+/// pages to reduce TLB misses and falls back to normal pages otherwise. On
+/// input 'size' is the requested size in bytes, on output the size actually
+/// allocated, which has to be passed back to aligned_large_pages_free().
+/// 'desc' receives a short description of the kind of memory obtained. If
+/// 'interleave' is set, the pages are interleaved across all NUMA nodes.
+///
+/// map_file() maps 'size' bytes of a file, starting at the page aligned
+/// 'offset', as private copy-on-write memory. The memory is released with
+/// aligned_large_pages_free() as well. Where this is not supported it returns
+/// nullptr and the caller has to read the file instead.
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+namespace {
+
+/// mmap_aligned() maps anonymous memory aligned to the given power of 2
+/// boundary by over-allocating and unmapping the surplus at both ends.
+
+void* mmap_aligned(size_t size, size_t alignment) {
+
+  void* mem = mmap(nullptr, size + alignment, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+      return nullptr;
+
+  uintptr_t start = uintptr_t(mem);
+  uintptr_t aligned = (start + alignment - 1) & ~uintptr_t(alignment - 1);
+
+  if (aligned > start)
+      munmap(mem, aligned - start);
+  munmap((void*)(aligned + size), start + alignment - aligned);
+
+  return (void*)aligned;
+}
+
+/// read_list() parses a sysfs list of ranges like "0-3,8-11" into its numbers
+
+vector<int> read_list(const string& path) {
+
+  vector<int> list;
+  ifstream file(path);
+  string range;
+  while (getline(file, range, ','))
+  {
+      int first, last;
+      char dash;
+      istringstream ss(range);
+      if (!(ss >> first))
+          continue;
+      last = (ss >> dash >> last) ? last : first;
+
+      for (int n = first; n <= last; ++n)
+          list.push_back(n);
+  }
+  return list;
+}
+
+/// interleave_nodes() sets an interleaved memory policy over all online NUMA
+/// nodes for the given range, before any of its pages have been touched.
+/// Returns the number of nodes, or 0 if the policy was not applied.
+
+int interleave_nodes(void* mem, size_t size) {
+
+  constexpr int MaxNodes = 1024;
+  constexpr int MPOL_INTERLEAVE = 3; // From <linux/mempolicy.h>
+  constexpr int Bits = 8 * sizeof(unsigned long);
+  unsigned long mask[MaxNodes / Bits] = {};
+
+  vector<int> nodes = read_list("/sys/devices/system/node/online");
+  if (nodes.size() < 2)
+      return 0;
+
+  for (int n : nodes)
+      if (n < MaxNodes)
+          mask[n / Bits] |= 1UL << (n % Bits);
+
+  return syscall(SYS_mbind, mem, size, MPOL_INTERLEAVE, mask, MaxNodes, 0) ? 0 : int(nodes.size());
+}
+
+} // namespace
+
+void* aligned_large_pages_alloc(size_t& size, bool interleave, string& desc) {
+
+  constexpr size_t HugePageSize = 2 * 1024 * 1024;
+  void* mem = nullptr;
+
+  // Explicit huge pages need to be reserved by the administrator beforehand,
+  // otherwise the mapping fails immediately.
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+  for (int log2Size : { 30, 21 })
+  {
+      size_t pageSize = size_t(1) << log2Size;
+      size_t allocSize = (size + pageSize - 1) & ~(pageSize - 1);
+
+      if (pageSize > HugePageSize && size < pageSize)
+          continue;
+
+      mem = mmap(nullptr, allocSize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (log2Size << MAP_HUGE_SHIFT), -1, 0);
+      if (mem != MAP_FAILED)
+      {
+          size = allocSize;
+          desc = log2Size == 30 ? "1GB huge pages" : "2MB huge pages";
+          break;
+      }
+      mem = nullptr;
+  }
+#endif
+
+  // Otherwise ask for transparent huge pages on a suitably aligned mapping
+  if (!mem)
+  {
+      size = (size + HugePageSize - 1) & ~(HugePageSize - 1);
+      mem = mmap_aligned(size, HugePageSize);
+      if (!mem)
+          return nullptr;
+
+      desc = madvise(mem, size, MADV_HUGEPAGE) ? "normal pages" : "transparent huge pages";
+  }
+
+  if (interleave)
+  {
+      int nodes = interleave_nodes(mem, size);
+      desc += nodes ? ", interleaved over " + std::to_string(nodes) + " NUMA nodes"
+                    : ", NUMA interleaving not available";
+  }
+
+  return mem;
+}
+
+void aligned_large_pages_free(void* mem, size_t size) {
+
+  if (mem)
+      munmap(mem, size);
+}
+
+void* map_file(const string& fname, size_t offset, size_t size) {
+
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd == -1)
+      return nullptr;
+
+  // Private writable mapping: the file is never modified, pages are copied
+  // only once they are written to.
+  void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset);
+  close(fd);
+
+  return mem == MAP_FAILED ? nullptr : mem;
+}
+
+#elif defined(_WIN32)
+
+void* aligned_large_pages_alloc(size_t& size, bool interleave, string& desc) {
+
+  void* mem = nullptr;
+  const size_t largePageSize = GetLargePageMinimum();
+
+  // Large pages require the SeLockMemoryPrivilege, which has to be granted to
+  // the user and then enabled for the process.
+  HANDLE token;
+  LUID luid;
+  if (   largePageSize
+      && OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+  {
+      if (LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &luid))
+      {
+          TOKEN_PRIVILEGES tp {}, prevTp {};
+          DWORD prevTpLen = 0;
+          tp.PrivilegeCount = 1;
+          tp.Privileges[0].Luid = luid;
+          tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+          // AdjustTokenPrivileges() may succeed without granting the privilege,
+          // so we need to check GetLastError() as well.
+          if (   AdjustTokenPrivileges(token, FALSE, &tp, sizeof(TOKEN_PRIVILEGES), &prevTp, &prevTpLen)
+              && GetLastError() == ERROR_SUCCESS)
+          {
+              size_t allocSize = (size + largePageSize - 1) & ~(largePageSize - 1);
+              mem = VirtualAlloc(nullptr, allocSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+              if (mem)
+              {
+                  size = allocSize;
+                  desc = "large pages";
+              }
+
+              // Restore the previous state of the privilege
+              AdjustTokenPrivileges(token, FALSE, &prevTp, 0, nullptr, nullptr);
+          }
+      }
+      CloseHandle(token);
+  }
+
+  if (!mem)
+  {
+      mem = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+      desc = "normal pages";
+  }
+
+  // Windows places pages on the node of the first touching thread
+  if (interleave)
+      desc += ", NUMA interleaving not available";
+
+  return mem;
+}
+
+void aligned_large_pages_free(void* mem, size_t) {
+
+  if (mem)
+      VirtualFree(mem, 0, MEM_RELEASE);
+}
+
+void* map_file(const string&, size_t, size_t) { return nullptr; }
+
+#else
+
+void* aligned_large_pages_alloc(size_t& size, bool interleave, string& desc) {
+
+  constexpr size_t Alignment = 4096;
+  void* mem = nullptr;
+
+  size = (size + Alignment - 1) & ~(Alignment - 1);
+  if (posix_memalign(&mem, Alignment, size))
+      return nullptr;
+
+  desc = interleave ? "normal pages, NUMA interleaving not available" : "normal pages";
+  return mem;
+}
+
+void aligned_large_pages_free(void* mem, size_t) {
+  free(mem);
+}
+
+void* map_file(const string&, size_t, size_t) { return nullptr; }
+
+#endif
+
+
 namespace WinProcGroup {
 
-#ifndef _WIN32
+#if defined(__linux__) && !defined(__ANDROID__)
+
+/// get_node() reads the NUMA topology from sysfs and returns the node for the
+/// thread with index idx, or -1 to leave the placement to the OS. Nodes are
+/// filled in the same way as the processor groups on Windows: first one thread
+/// per physical core, then the remaining logical processors spread evenly.
+
+int get_node(size_t idx, cpu_set_t& cpus) {
+
+  vector<int> nodes = read_list("/sys/devices/system/node/online");
+  vector<int> groups;
+  int threads = 0;
+
+  if (nodes.size() < 2)
+      return -1;
+
+  for (int n : nodes)
+  {
+      for (int cpu : read_list("/sys/devices/system/node/node" + to_string(n) + "/cpulist"))
+      {
+          // The first logical processor of each core stands for the core
+          vector<int> siblings = read_list("/sys/devices/system/cpu/cpu" + to_string(cpu)
+                                           + "/topology/thread_siblings_list");
+          if (siblings.empty() || siblings[0] == cpu)
+              groups.push_back(n);
+          threads++;
+      }
+  }
+
+  for (int t = 0, cores = int(groups.size()); t < threads - cores; t++)
+      groups.push_back(nodes[t % nodes.size()]);
+
+  if (idx >= groups.size())
+      return -1;
+
+  CPU_ZERO(&cpus);
+  for (int cpu : read_list("/sys/devices/system/node/node" + to_string(groups[idx]) + "/cpulist"))
+      if (cpu < CPU_SETSIZE)
+          CPU_SET(cpu, &cpus);
+
+  return groups[idx];
+}
+
+
+/// bindThisThread() sets the affinity of the current thread to the logical
+/// processors of its NUMA node. Memory allocated afterwards by the thread is
+/// then placed on this node by the default local allocation policy.
+
+void bindThisThread(size_t idx) {
+
+  cpu_set_t cpus;
+
+  if (get_node(idx, cpus) != -1)
+      sched_setaffinity(0, sizeof(cpu_set_t), &cpus);
+}
+
+#elif !defined(_WIN32)
 
 void bindThisThread(size_t) {}
 
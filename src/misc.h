@@ -21,8 +21,11 @@
 #ifndef MISC_H_INCLUDED
 #define MISC_H_INCLUDED
 
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstring>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -32,7 +35,11 @@
 const std::string engine_info(bool to_uci = false);
 void prefetch(void* addr);
 void prefetch2(void* addr);
+bool fast_pext();
 void start_logger(const std::string& fname);
+void* aligned_large_pages_alloc(size_t& size, bool interleave, std::string& desc);
+void aligned_large_pages_free(void* mem, size_t size);
+void* map_file(const std::string& fname, size_t offset, size_t size);
 
 void dbg_hit_on(bool b);
 void dbg_hit_on(bool c, bool b);
@@ -48,12 +55,103 @@ inline TimePoint now() {
         (std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-template<class Entry, int Size>
+/// HashTable is a per-thread table of a power of 2 number of entries, used for
+/// the pawn and material hashes. It also counts hits and misses of its probes,
+/// shared hits are misses that were served by a SharedHashTable.
+
+template<class Entry, int DefaultSize>
 struct HashTable {
-  Entry* operator[](Key key) { return &table[(uint32_t)key & (Size - 1)]; }
+  Entry* operator[](Key key) { return &table[(uint32_t)key & mask]; }
+
+  // Resize to the largest power of 2 not above the given number of entries
+  void resize(size_t size) {
+    size_t n = 1;
+    while (n * 2 <= size)
+        n *= 2;
+    table.assign(n, Entry());
+    mask = n - 1;
+  }
+
+  size_t size() const { return table.size(); }
+  void clear_stats() { hits = sharedHits = misses = 0; }
+
+  uint64_t hits = 0, sharedHits = 0, misses = 0;
 
 private:
-  std::vector<Entry> table = std::vector<Entry>(Size);
+  std::vector<Entry> table = std::vector<Entry>(DefaultSize);
+  size_t mask = DefaultSize - 1;
+};
+
+
+/// SharedHashTable is an optional lock-free cache shared by all threads, used
+/// as a second level behind the per-thread HashTable. Entries are copied in and
+/// out, so a pointer to a thread's own entry stays valid as before. Each slot
+/// has a sequence number which is odd while the slot is being written, readers
+/// discard their copy if the number changed while they were reading it.
+
+template<class Entry>
+struct SharedHashTable {
+
+  void resize(size_t mbSize) {
+    constexpr size_t MaxMbSize = 1024; // Maximum of the "Shared Eval Cache" option
+    count = std::min(mbSize, MaxMbSize) * 1024 * 1024 / sizeof(Slot);
+    table.reset(count ? new Slot[count]() : nullptr);
+  }
+
+  void clear() {
+    for (size_t i = 0; i < count; ++i)
+        table[i].seq = 0, std::memset(&table[i].entry, 0, sizeof(Entry));
+  }
+
+  bool probe(Key key, Entry& e) const {
+
+    if (!count)
+        return false;
+
+    const Slot& s = slot(key);
+    uint32_t seq = s.seq.load(std::memory_order_acquire);
+    if (seq & 1)
+        return false;
+
+    Entry copy;
+    std::memcpy(&copy, &s.entry, sizeof(Entry));
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (s.seq.load(std::memory_order_relaxed) != seq || copy.key != key)
+        return false;
+
+    e = copy;
+    return true;
+  }
+
+  void store(const Entry& e) {
+
+    if (!count)
+        return;
+
+    Slot& s = slot(e.key);
+    uint32_t seq = s.seq.load(std::memory_order_relaxed);
+
+    // Skip the store if another thread is writing the slot
+    if ((seq & 1) || !s.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire))
+        return;
+
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&s.entry, &e, sizeof(Entry));
+    s.seq.store(seq + 2, std::memory_order_release);
+  }
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> seq;
+    Entry entry;
+  };
+
+  // Use the upper half of the key, the lower one indexes the per-thread tables
+  Slot& slot(Key key) const { return table[(uint32_t(key >> 32) * uint64_t(count)) >> 32]; }
+
+  std::unique_ptr<Slot[]> table;
+  size_t count = 0;
 };
 
 
@@ -105,7 +203,7 @@ public:
 /// logical processor group. This usually means to be limited to use max 64
 /// cores. To overcome this, some special platform specific API should be
 /// called to set group affinity for each thread. Original code from Texel by
-/// Peter Österlund.
+/// Peter Österlund. On Linux the same scheme binds threads to NUMA nodes.
 
 namespace WinProcGroup {
   void bindThisThread(size_t idx);
@@ -83,7 +83,7 @@ namespace {
     if (pos.count_in_hand(Us, pt))
     {
         // Restrict to valid target
-        b &= pos.drop_region(Us, pt);
+        b = pos.drop_region(Us, pt, b);
 
         // Add to move list
         if (pos.drop_promoted() && pos.promoted_piece_type(pt))
@@ -325,18 +325,31 @@ namespace {
   }
 
 
-  template<Color Us, GenType Type>
+  // Parts of the moves generated by generate_all()
+  enum MoveParts { BOARD_MOVES = 1, DROP_MOVES = 2, ALL_MOVES = BOARD_MOVES | DROP_MOVES };
+
+  template<Color Us, GenType Type, MoveParts Parts = ALL_MOVES>
   ExtMove* generate_all(const Position& pos, ExtMove* moveList, Bitboard target) {
 
     constexpr bool Checks = Type == QUIET_CHECKS;
 
-    moveList = generate_pawn_moves<Us, Type>(pos, moveList, target);
-    for (PieceType pt = PieceType(PAWN + 1); pt < KING; ++pt)
-        moveList = generate_moves<Checks>(pos, moveList, Us, pt, target);
+    if (Parts & BOARD_MOVES)
+    {
+        moveList = generate_pawn_moves<Us, Type>(pos, moveList, target);
+        for (PieceType pt = PieceType(PAWN + 1); pt < KING; ++pt)
+            moveList = generate_moves<Checks>(pos, moveList, Us, pt, target);
+    }
     // generate drops
-    if (pos.piece_drops() && Type != CAPTURES && pos.count_in_hand(Us, ALL_PIECES))
+    if ((Parts & DROP_MOVES) && pos.piece_drops() && Type != CAPTURES && pos.count_in_hand(Us, ALL_PIECES))
+    {
+        // The drop targets common to all piece types are computed only once
+        Bitboard dropTargets = target & ~pos.pieces(~Us) & pos.drop_targets(Us);
         for (PieceType pt = PAWN; pt <= KING; ++pt)
-            moveList = generate_drops<Us, Checks>(pos, moveList, pt, target & ~pos.pieces(~Us));
+            moveList = generate_drops<Us, Checks>(pos, moveList, pt, dropTargets);
+    }
+
+    if (!(Parts & BOARD_MOVES))
+        return moveList;
 
     if (Type != QUIET_CHECKS && Type != EVASIONS && pos.count<KING>(Us))
     {
@@ -398,6 +411,34 @@ template ExtMove* generate<QUIETS>(const Position&, ExtMove*);
 template ExtMove* generate<NON_EVASIONS>(const Position&, ExtMove*);
 
 
+/// generate<BOARD_QUIETS> generates the same moves as generate<QUIETS> except
+/// for the drops, which are generated by generate<DROPS>. This allows to generate
+/// the drops only when they are needed. Returns a pointer to the end of the move list.
+template<>
+ExtMove* generate<BOARD_QUIETS>(const Position& pos, ExtMove* moveList) {
+
+  assert(!pos.checkers());
+
+  Color us = pos.side_to_move();
+  Bitboard target = ~pos.pieces() & pos.board_bb();
+
+  return us == WHITE ? generate_all<WHITE, QUIETS, BOARD_MOVES>(pos, moveList, target)
+                     : generate_all<BLACK, QUIETS, BOARD_MOVES>(pos, moveList, target);
+}
+
+template<>
+ExtMove* generate<DROPS>(const Position& pos, ExtMove* moveList) {
+
+  assert(!pos.checkers());
+
+  Color us = pos.side_to_move();
+  Bitboard target = ~pos.pieces() & pos.board_bb();
+
+  return us == WHITE ? generate_all<WHITE, QUIETS, DROP_MOVES>(pos, moveList, target)
+                     : generate_all<BLACK, QUIETS, DROP_MOVES>(pos, moveList, target);
+}
+
+
 /// generate<QUIET_CHECKS> generates all pseudo-legal non-captures and knight
 /// underpromotions that give check. Returns a pointer to the end of the move list.
 template<>
@@ -30,6 +30,8 @@ class Position;
 enum GenType {
   CAPTURES,
   QUIETS,
+  BOARD_QUIETS,
+  DROPS,
   QUIET_CHECKS,
   EVASIONS,
   NON_EVASIONS,
@@ -21,6 +21,7 @@
 #include <cassert>
 
 #include "movepick.h"
+#include "thread.h"
 
 namespace {
 
@@ -31,6 +32,22 @@ namespace {
     QSEARCH_TT, QCAPTURE_INIT, QCAPTURE, QCHECK_INIT, QCHECK
   };
 
+  // Stage a picked move is counted by in the search statistics
+  constexpr SearchStats::PickStage PickStages[] = {
+    SearchStats::PICK_TT, SearchStats::PICK_GOOD_CAPTURE, SearchStats::PICK_GOOD_CAPTURE,
+    SearchStats::PICK_REFUTATION, SearchStats::PICK_QUIET, SearchStats::PICK_QUIET,
+    SearchStats::PICK_BAD_CAPTURE,
+    SearchStats::PICK_TT, SearchStats::PICK_EVASION, SearchStats::PICK_EVASION,
+    SearchStats::PICK_TT, SearchStats::PICK_PROBCUT, SearchStats::PICK_PROBCUT,
+    SearchStats::PICK_TT, SearchStats::PICK_QCAPTURE, SearchStats::PICK_QCAPTURE,
+    SearchStats::PICK_QCHECK, SearchStats::PICK_QCHECK
+  };
+
+  static_assert(sizeof(PickStages) / sizeof(PickStages[0]) == QCHECK + 1, "Missing pick stage");
+
+  // History score below which the board quiets are ordered together with the drops
+  constexpr int DropHistoryThreshold = 0;
+
   // Helper filter used with select()
   const auto Any = [](){ return true; };
 
@@ -52,6 +69,45 @@ namespace {
 } // namespace
 
 
+/// ContinuationHistory::resize() lays out the tables for the given variant, and
+/// returns whether they have been reallocated, in which case they are cleared
+/// and the caller has to set them up again. Pieces which are not expected in
+/// the variant share a last piece number, to be safe with custom variants.
+
+bool ContinuationHistory::resize(const Variant* v) {
+
+  if (v == var)
+      return false;
+
+  var = v;
+
+  std::set<PieceType> pieceTypes(v->pieceTypes);
+  for (PieceType pt : v->pieceTypes)
+      if (v->promotedPieceType[pt])
+          pieceTypes.insert(v->promotedPieceType[pt]);
+  pieceTypes.insert(v->promotionPieceTypes.begin(), v->promotionPieceTypes.end());
+
+  const int squareCnt = make_square(v->maxFile, v->maxRank) + 1;
+  const int pieceCnt = 2 * int(pieceTypes.size()) + 2; // With NO_PIECE and the others
+
+  std::fill(pieceOffset, pieceOffset + PIECE_NB, (pieceCnt - 1) * squareCnt);
+  pieceOffset[NO_PIECE] = 0;
+  int n = 1;
+  for (Color c : { WHITE, BLACK })
+      for (PieceType pt : pieceTypes)
+          pieceOffset[make_piece(c, pt)] = n++ * squareCnt;
+
+  const int size = pieceCnt * squareCnt;
+  entries.assign(size_t(size) * size, PieceToHistory::Entry());
+  tables.clear();
+  tables.reserve(size);
+  for (int i = 0; i < size; ++i)
+      tables.emplace_back(&entries[size_t(i) * size], pieceOffset, size);
+
+  return true;
+}
+
+
 /// Constructors of the MovePicker class. As arguments we pass information
 /// to help it to return the (presumably) good moves first, to decide which
 /// moves to return (in the quiescence search, for instance, we only want to
@@ -150,8 +206,19 @@ Move MovePicker::select(Pred filter) {
 /// MovePicker::next_move() is the most important method of the MovePicker class. It
 /// returns a new pseudo legal move every time it is called until there are no more
 /// moves left, picking the move with the highest score from a list of generated moves.
+/// The TT move is returned after its stage has been left, all the others from
+/// the stage they were picked in.
 Move MovePicker::next_move(bool skipQuiets) {
 
+  Move m = pick_move(skipQuiets);
+  if (m != MOVE_NONE)
+      pos.this_thread()->stats.picked[PickStages[m == ttMove ? stage - 1 : stage]]++;
+  return m;
+}
+
+/// MovePicker::pick_move() runs the stages of the move picker until a move is found
+Move MovePicker::pick_move(bool skipQuiets) {
+
 top:
   switch (stage) {
 
@@ -200,8 +267,12 @@ top:
       /* fallthrough */
 
   case QUIET_INIT:
+      // In drop variants the drops are only generated in the QUIET stage, once
+      // no board quiet with a good history is left.
       cur = endBadCaptures;
-      endMoves = generate<QUIETS>(pos, cur);
+      dropsPending = pos.piece_drops();
+      endMoves = dropsPending ? generate<BOARD_QUIETS>(pos, cur)
+                              : generate<QUIETS>(pos, cur);
 
       score<QUIETS>();
       partial_insertion_sort(cur, endMoves, -4000 * depth / ONE_PLY);
@@ -209,11 +280,31 @@ top:
       /* fallthrough */
 
   case QUIET:
-      if (   !skipQuiets
-          && select<Next>([&](){return   move != refutations[0]
-                                      && move != refutations[1]
-                                      && move != refutations[2];}))
-          return move;
+      if (!skipQuiets)
+      {
+          auto notRefutation = [&](){return   move != refutations[0]
+                                           && move != refutations[1]
+                                           && move != refutations[2];};
+          bool found = select<Next>(notRefutation);
+
+          // Once the next board quiet has a bad history, the drops are added
+          // and the remaining quiets are ordered together with them.
+          if (dropsPending && (!found || (cur - 1)->value < DropHistoryThreshold))
+          {
+              ExtMove* rest = cur - found;
+              cur = endMoves;
+              endMoves = generate<DROPS>(pos, cur);
+              score<QUIETS>();
+
+              cur = rest;
+              partial_insertion_sort(cur, endMoves, -4000 * depth / ONE_PLY);
+              dropsPending = false;
+              found = select<Next>(notRefutation);
+          }
+
+          if (found)
+              return move;
+      }
 
       // Prepare the pointers to loop over the bad captures
       cur = moves;
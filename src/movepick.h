@@ -21,9 +21,11 @@
 #ifndef MOVEPICK_H_INCLUDED
 #define MOVEPICK_H_INCLUDED
 
+#include <algorithm>
 #include <array>
 #include <limits>
 #include <type_traits>
+#include <vector>
 
 #include "movegen.h"
 #include "position.h"
@@ -94,13 +96,50 @@ typedef Stats<Move, NOT_USED, PIECE_NB, SQUARE_NB> CounterMoveHistory;
 /// CapturePieceToHistory is addressed by a move's [piece][to][captured piece type]
 typedef Stats<int16_t, 10368, PIECE_NB, SQUARE_NB, PIECE_TYPE_NB> CapturePieceToHistory;
 
-/// PieceToHistory is like ButterflyHistory but is addressed by a move's [piece][to]
-typedef Stats<int16_t, 29952, PIECE_NB, SQUARE_NB> PieceToHistory;
+/// PieceToHistory is like ButterflyHistory but is addressed by a move's [piece][to].
+/// It is one of the tables of a ContinuationHistory, which numbers the pieces
+/// and squares of the variant, so that it has no entries for unused ones.
+class PieceToHistory {
+
+public:
+  typedef StatsEntry<int16_t, 29952> Entry;
+
+  PieceToHistory(Entry* e, const int* offsets, int n) : entries(e), pieceOffset(offsets), size(n) {}
+
+  Entry*       operator[](Piece pc)       { return entries + pieceOffset[pc]; }
+  const Entry* operator[](Piece pc) const { return entries + pieceOffset[pc]; }
+
+  void fill(int16_t v) { std::fill(entries, entries + size, v); }
+
+private:
+  Entry* entries;
+  const int* pieceOffset;
+  int size;
+};
 
 /// ContinuationHistory is the combined history of a given pair of moves, usually
 /// the current one given a previous one. The nested history table is based on
-/// PieceToHistory instead of ButterflyBoards.
-typedef Stats<PieceToHistory, NOT_USED, PIECE_NB, SQUARE_NB> ContinuationHistory;
+/// PieceToHistory instead of ButterflyBoards. Both levels are addressed by
+/// [piece][to], with the pieces of the variant numbered densely and the squares
+/// up to the last one of the board, so that the size is (pieces x squares)^2
+/// for the variant instead of (PIECE_NB x SQUARE_NB)^2. It is laid out for a
+/// variant by resize(), and empty before.
+class ContinuationHistory {
+
+public:
+  bool resize(const Variant* v);
+  void fill(int16_t v) { std::fill(entries.begin(), entries.end(), v); }
+  size_t size() const { return tables.size(); }
+  const Variant* variant() const { return var; }
+
+  PieceToHistory* operator[](Piece pc) { return tables.data() + pieceOffset[pc]; }
+
+private:
+  const Variant* var = nullptr;
+  int pieceOffset[PIECE_NB];
+  std::vector<PieceToHistory::Entry> entries;
+  std::vector<PieceToHistory> tables;
+};
 
 
 /// MovePicker class is used to pick one pseudo legal move at a time from the
@@ -128,6 +167,7 @@ public:
   Move next_move(bool skipQuiets = false);
 
 private:
+  Move pick_move(bool skipQuiets);
   template<PickType T, typename Pred> Move select(Pred);
   template<GenType> void score();
   ExtMove* begin() { return cur; }
@@ -140,6 +180,7 @@ private:
   Move ttMove;
   ExtMove refutations[3], *cur, *endMoves, *endBadCaptures;
   int stage;
+  bool dropsPending;
   Move move;
   Square recaptureSquare;
   Value threshold;
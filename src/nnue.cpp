@@ -0,0 +1,435 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>   // For std::memcmp, std::memcpy
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#if defined(USE_AVX2)
+#include <immintrin.h>
+#elif defined(USE_SSSE3)
+#include <tmmintrin.h>
+#endif
+
+#include "bitboard.h"
+#include "misc.h"
+#include "nnue.h"
+#include "position.h"
+#include "uci.h"
+#include "variant.h"
+
+namespace {
+
+  using Eval::NNUE::Accumulator;
+  using Eval::NNUE::DirtyPiece;
+  using Eval::NNUE::TransformedFeatureDimensions;
+
+  // Header of the network file format. The parameters follow, all of them little
+  // endian: the biases and the weights of each input of the feature transformer,
+  // then the biases and the weights of each output of the hidden layers and of
+  // the output layer. Each layer but the last takes the outputs of the previous
+  // one clipped to [0, 127], for the first one those of the side to move first.
+  constexpr char FileMagic[8] = { 'F', 'S', 'F', 'N', 'N', 'U', 'E', '\0' };
+  constexpr uint32_t FileVersion = 1;
+  constexpr int HiddenDimensions = 32;
+
+  struct FileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t files;
+    uint32_t ranks;
+    uint32_t pieceTypes; // Those of the variant and their promoted types
+    uint32_t handSlots;  // Inputs for the pieces of a type in a hand
+    uint32_t dimensions[3];
+    char     variant[64];
+  };
+
+  constexpr int WeightScaleBits = 6; // Scale of the weights of the hidden layers
+  constexpr int OutputScale = 16;
+
+  // Updating the accumulator from one more than this number of positions back
+  // is not tried, computing it from scratch is usually as fast.
+  constexpr int MaxUpdatePlies = 8;
+
+  // AffineLayer computes the outputs of a layer from the clipped outputs of the
+  // previous one.
+  template<int InDims, int OutDims>
+  struct AffineLayer {
+
+    static_assert(InDims % 32 == 0, "Inputs are processed by blocks of 32");
+
+    int32_t biases[OutDims];
+    int8_t weights[OutDims][InDims];
+
+    bool read(std::istream& is) {
+      is.read((char*)biases, sizeof(biases));
+      is.read((char*)weights, sizeof(weights));
+      return bool(is);
+    }
+
+    void propagate(const uint8_t* input, int32_t* output) const {
+
+      for (int i = 0; i < OutDims; ++i)
+      {
+#if defined(USE_AVX2)
+          __m256i sum = _mm256_setzero_si256();
+          for (int j = 0; j < InDims; j += 32)
+          {
+              __m256i product = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)&input[j]),
+                                                     _mm256_loadu_si256((const __m256i*)&weights[i][j]));
+              sum = _mm256_add_epi32(sum, _mm256_madd_epi16(product, _mm256_set1_epi16(1)));
+          }
+          __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+#elif defined(USE_SSSE3)
+          __m128i sum128 = _mm_setzero_si128();
+          for (int j = 0; j < InDims; j += 16)
+          {
+              __m128i product = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)&input[j]),
+                                                  _mm_loadu_si128((const __m128i*)&weights[i][j]));
+              sum128 = _mm_add_epi32(sum128, _mm_madd_epi16(product, _mm_set1_epi16(1)));
+          }
+#endif
+#if defined(USE_AVX2) || defined(USE_SSSE3)
+          sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+          sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+          output[i] = biases[i] + _mm_cvtsi128_si32(sum128);
+#else
+          int32_t sum = biases[i];
+          for (int j = 0; j < InDims; ++j)
+              sum += weights[i][j] * input[j];
+          output[i] = sum;
+#endif
+      }
+    }
+  };
+
+  // Network holds the parameters of the network of the current variant
+  struct Network {
+    const Variant* variant;  // nullptr if there is no network
+    int files, ranks, handSlots, boardFeatures;
+    int pieceIndex[PIECE_TYPE_NB];
+    std::vector<int16_t> biases;
+    std::vector<int16_t> weights;
+    AffineLayer<2 * TransformedFeatureDimensions, HiddenDimensions> hidden1;
+    AffineLayer<HiddenDimensions, HiddenDimensions> hidden2;
+    AffineLayer<HiddenDimensions, 1> output;
+  };
+
+  Network net;
+
+
+  // feature() returns the input of the feature transformer of a piece from the
+  // point of view of a player, or -1 for a piece in hand beyond the last input.
+  // The board is flipped for black, so that both players see the same inputs.
+  int feature(Color perspective, Piece pc, Square s, int idx) {
+
+    assert(net.pieceIndex[type_of(pc)] >= 0);
+
+    int p = 2 * net.pieceIndex[type_of(pc)] + (color_of(pc) != perspective);
+
+    if (s == SQ_NONE)
+        return idx < net.handSlots ? net.boardFeatures + p * net.handSlots + idx : -1;
+
+    int r = perspective == WHITE ? rank_of(s) : net.ranks - 1 - rank_of(s);
+    return (p * net.ranks + r) * net.files + file_of(s);
+  }
+
+
+  // add_feature() adds or subtracts the weights of an input to the accumulation
+  // of a player.
+  void add_feature(int16_t* acc, int f, bool add) {
+
+    if (f < 0)
+        return;
+
+    const int16_t* w = &net.weights[size_t(f) * TransformedFeatureDimensions];
+
+#if defined(USE_AVX2)
+    for (int i = 0; i < TransformedFeatureDimensions; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)&acc[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i*)&w[i]);
+        _mm256_storeu_si256((__m256i*)&acc[i], add ? _mm256_add_epi16(a, b) : _mm256_sub_epi16(a, b));
+    }
+#else
+    for (int i = 0; i < TransformedFeatureDimensions; ++i)
+        acc[i] = int16_t(add ? acc[i] + w[i] : acc[i] - w[i]);
+#endif
+  }
+
+
+  // compute_accumulator() computes an accumulator from scratch
+  void compute_accumulator(const Position& pos, Accumulator& acc) {
+
+    for (Color perspective : { WHITE, BLACK })
+    {
+        int16_t* a = acc.accumulation[perspective];
+        std::memcpy(a, net.biases.data(), sizeof(acc.accumulation[perspective]));
+
+        Bitboard b = pos.pieces();
+        while (b)
+        {
+            Square s = pop_lsb(&b);
+            add_feature(a, feature(perspective, pos.piece_on(s), s, 0), true);
+        }
+
+        if (pos.piece_drops())
+            for (Color c : { WHITE, BLACK })
+                for (PieceType pt : pos.piece_types())
+                    for (int i = 0; i < std::min(pos.count_in_hand(c, pt), net.handSlots); ++i)
+                        add_feature(a, feature(perspective, make_piece(c, pt), SQ_NONE, i), true);
+    }
+
+    acc.computed = true;
+  }
+
+
+  // update_accumulator() computes the accumulator of the current position from
+  // the one of a previous position and the pieces changed since, if it is not
+  // too far back, otherwise from scratch.
+  void update_accumulator(const Position& pos) {
+
+    StateInfo* st = pos.state();
+
+    if (st->accumulator.computed)
+        return;
+
+    StateInfo* path[MaxUpdatePlies];
+    int n = 0, cost = 0, refreshCost = popcount(pos.pieces());
+
+    for (StateInfo* s = st; !s->accumulator.computed; s = s->previous)
+    {
+        cost += s->dirtyPiece.dirtyNum;
+        if (!s->previous || n == MaxUpdatePlies || cost > refreshCost)
+        {
+            compute_accumulator(pos, st->accumulator);
+            return;
+        }
+        path[n++] = s;
+    }
+
+    // The accumulators of the positions in between are computed on the way, they
+    // are likely to be needed for the other moves from them.
+    for (int k = n - 1; k >= 0; --k)
+    {
+        StateInfo* s = path[k];
+        const DirtyPiece& dp = s->dirtyPiece;
+
+        for (Color perspective : { WHITE, BLACK })
+        {
+            int16_t* a = s->accumulator.accumulation[perspective];
+            std::memcpy(a, s->previous->accumulator.accumulation[perspective],
+                        sizeof(s->accumulator.accumulation[perspective]));
+
+            for (int i = 0; i < dp.dirtyNum; ++i)
+                add_feature(a, feature(perspective, dp.piece[i], dp.square[i], dp.index[i]), dp.added[i]);
+        }
+        s->accumulator.computed = true;
+    }
+
+#ifndef NDEBUG
+    Accumulator acc;
+    compute_accumulator(pos, acc);
+    assert(!std::memcmp(acc.accumulation, st->accumulator.accumulation, sizeof(acc.accumulation)));
+#endif
+  }
+
+
+  // transform() clips the accumulation of each player to [0, 127], those of the
+  // side to move first.
+  void transform(const Accumulator& acc, Color us, uint8_t* output) {
+
+    for (Color perspective : { us, ~us })
+    {
+        const int16_t* a = acc.accumulation[perspective];
+        uint8_t* out = &output[perspective == us ? 0 : TransformedFeatureDimensions];
+
+#if defined(USE_AVX2)
+        for (int i = 0; i < TransformedFeatureDimensions; i += 32)
+        {
+            __m256i a0 = _mm256_max_epi16(_mm256_loadu_si256((const __m256i*)&a[i]), _mm256_setzero_si256());
+            __m256i a1 = _mm256_max_epi16(_mm256_loadu_si256((const __m256i*)&a[i + 16]), _mm256_setzero_si256());
+            // Packing works within each 128 bit lane, so the lanes are reordered
+            _mm256_storeu_si256((__m256i*)&out[i], _mm256_permute4x64_epi64(_mm256_packs_epi16(a0, a1), 0xD8));
+        }
+#elif defined(USE_SSSE3)
+        for (int i = 0; i < TransformedFeatureDimensions; i += 16)
+        {
+            __m128i a0 = _mm_max_epi16(_mm_loadu_si128((const __m128i*)&a[i]), _mm_setzero_si128());
+            __m128i a1 = _mm_max_epi16(_mm_loadu_si128((const __m128i*)&a[i + 8]), _mm_setzero_si128());
+            _mm_storeu_si128((__m128i*)&out[i], _mm_packs_epi16(a0, a1));
+        }
+#else
+        for (int i = 0; i < TransformedFeatureDimensions; ++i)
+            out[i] = uint8_t(std::max(0, std::min(127, int(a[i]))));
+#endif
+    }
+  }
+
+
+  // clip() scales down the outputs of a hidden layer and clips them to [0, 127]
+  void clip(const int32_t* input, uint8_t* output, int n) {
+
+    for (int i = 0; i < n; ++i)
+        output[i] = uint8_t(std::max(0, std::min(127, input[i] >> WeightScaleBits)));
+  }
+
+  // propagate() computes the output of the network for the side to move
+  Value propagate(const Accumulator& acc, Color us) {
+
+    uint8_t transformed[2 * TransformedFeatureDimensions];
+    uint8_t hidden[2][HiddenDimensions];
+    int32_t sums[HiddenDimensions];
+
+    transform(acc, us, transformed);
+    net.hidden1.propagate(transformed, sums);
+    clip(sums, hidden[0], HiddenDimensions);
+    net.hidden2.propagate(hidden[0], sums);
+    clip(sums, hidden[1], HiddenDimensions);
+    net.output.propagate(hidden[1], sums);
+
+    // Keep the evaluation clear of the mate scores
+    return Value(std::max(int(VALUE_MATED_IN_MAX_PLY) + 1,
+                          std::min(int(VALUE_MATE_IN_MAX_PLY) - 1, sums[0] / OutputScale)));
+  }
+
+} // namespace
+
+
+namespace Eval {
+
+namespace NNUE {
+
+/// init() loads the network of the current variant, which is the file
+/// "<variant>.nnue" in the directory given by the "NNUE Path" option. Without
+/// a network, the classical evaluation is used.
+
+void init() {
+
+  net.variant = nullptr;
+
+  std::string path = Options["NNUE Path"], var = Options["UCI_Variant"];
+  if (path.empty() || path == "<empty>")
+      return;
+
+  std::string fname = path + "/" + var + ".nnue", error;
+  std::ifstream file(fname, std::ios::binary | std::ios::ate);
+  if (!file)
+      return;
+
+  size_t fileSize = size_t(file.tellg());
+  FileHeader header = {};
+  file.seekg(0);
+  file.read((char*)&header, sizeof(FileHeader));
+  header.variant[sizeof(header.variant) - 1] = '\0';
+
+  // The pieces of the variant, including their promoted types, in the order of
+  // their types
+  const Variant* v = variants.find(var)->second;
+  std::set<PieceType> pieceTypes = v->pieceTypes;
+  for (PieceType pt : v->pieceTypes)
+      if (v->promotedPieceType[pt])
+          pieceTypes.insert(v->promotedPieceType[pt]);
+
+  std::fill(std::begin(net.pieceIndex), std::end(net.pieceIndex), -1);
+  int n = 0;
+  for (PieceType pt : pieceTypes)
+      net.pieceIndex[pt] = n++;
+
+  net.files = v->maxFile + 1;
+  net.ranks = v->maxRank + 1;
+  net.handSlots = int(header.handSlots);
+  net.boardFeatures = 2 * n * net.files * net.ranks;
+  size_t features = size_t(net.boardFeatures) + 2 * n * size_t(header.handSlots);
+
+  if (!file || std::memcmp(header.magic, FileMagic, sizeof(FileMagic)))
+      error = "not a network file";
+  else if (header.version != FileVersion)
+      error = "incompatible file version";
+  else if (var != header.variant)
+      error = "made for variant " + std::string(header.variant);
+  else if (   header.files != uint32_t(net.files) || header.ranks != uint32_t(net.ranks)
+           || header.pieceTypes != uint32_t(n) || header.handSlots > 64)
+      error = "made for other pieces or another board";
+  else if (   header.dimensions[0] != TransformedFeatureDimensions
+           || header.dimensions[1] != HiddenDimensions
+           || header.dimensions[2] != HiddenDimensions)
+      error = "unsupported network size";
+  else if (fileSize !=  sizeof(FileHeader)
+                      + (features + 1) * TransformedFeatureDimensions * sizeof(int16_t)
+                      + sizeof(net.hidden1) + sizeof(net.hidden2) + sizeof(net.output))
+      error = "wrong file size";
+  else
+  {
+      net.biases.resize(TransformedFeatureDimensions);
+      net.weights.resize(features * TransformedFeatureDimensions);
+      file.read((char*)net.biases.data(), net.biases.size() * sizeof(int16_t));
+      file.read((char*)net.weights.data(), net.weights.size() * sizeof(int16_t));
+
+      if (!net.hidden1.read(file) || !net.hidden2.read(file) || !net.output.read(file))
+          error = "read error";
+  }
+
+  if (!error.empty())
+  {
+      net.weights.clear();
+      sync_cout << "info string NNUE file " << fname << " rejected: " << error << sync_endl;
+      return;
+  }
+
+  net.variant = v;
+  sync_cout << "info string NNUE evaluation using " << fname << sync_endl;
+}
+
+
+/// enabled() tells whether the position is evaluated by the network
+
+bool enabled(const Position& pos) {
+  return net.variant == pos.variant();
+}
+
+
+/// refresh() computes the accumulator of the position from scratch. It is done
+/// before the search for the root position, whose state is shared by the threads
+/// and may have been evaluated with another network.
+
+void refresh(const Position& pos) {
+
+  if (enabled(pos))
+      compute_accumulator(pos, pos.state()->accumulator);
+}
+
+
+/// evaluate() returns the evaluation of the network from the point of view of
+/// the side to move.
+
+Value evaluate(const Position& pos) {
+
+  assert(enabled(pos));
+
+  update_accumulator(pos);
+  return propagate(pos.state()->accumulator, pos.side_to_move());
+}
+
+} // namespace NNUE
+
+} // namespace Eval
@@ -0,0 +1,79 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NNUE_H_INCLUDED
+#define NNUE_H_INCLUDED
+
+#include <cstdint>
+
+#include "types.h"
+
+class Position;
+
+namespace Eval {
+
+/// The NNUE evaluation is an efficiently updatable neural network. Its first
+/// layer, the feature transformer, has an input for each piece of the variant
+/// on each square and for each piece in hand, seen from the side of each player.
+/// Since only a few of them change in a move, its outputs are kept in the state
+/// and updated from those of the previous position, see update_accumulator().
+
+namespace NNUE {
+
+constexpr int TransformedFeatureDimensions = 256; // Outputs for each side
+constexpr int MaxDirtyPieces = 6;
+
+/// DirtyPiece lists the inputs that a move turned on and off. A piece in hand
+/// has no square, it is the index-th piece of its type in the hand instead.
+
+struct DirtyPiece {
+  int dirtyNum;
+  Piece piece[MaxDirtyPieces];
+  Square square[MaxDirtyPieces];
+  int index[MaxDirtyPieces];
+  bool added[MaxDirtyPieces];
+
+  void add(Piece pc, Square s, bool on, int idx = 0) {
+    assert(dirtyNum < MaxDirtyPieces);
+    piece[dirtyNum] = pc;
+    square[dirtyNum] = s;
+    index[dirtyNum] = idx;
+    added[dirtyNum++] = on;
+  }
+};
+
+/// Accumulator holds the outputs of the feature transformer, from the point of
+/// view of each player.
+
+struct Accumulator {
+  int16_t accumulation[COLOR_NB][TransformedFeatureDimensions];
+  bool computed;
+};
+
+void init();
+bool enabled(const Position& pos);
+void refresh(const Position& pos);
+Value evaluate(const Position& pos);
+
+} // namespace NNUE
+
+} // namespace Eval
+
+#endif // #ifndef NNUE_H_INCLUDED
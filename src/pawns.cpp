@@ -180,6 +180,8 @@ namespace {
 
 namespace Pawns {
 
+SharedTable Shared; // Shared by all threads, empty unless enabled
+
 /// Pawns::init() initializes some tables needed by evaluation. Instead of using
 /// hard-coded tables, when makes sense, we prefer to calculate them with a formula
 /// to reduce independent parameters and to allow easier tuning and better insight.
@@ -209,10 +211,24 @@ void init() {
 Entry* probe(const Position& pos) {
 
   Key key = pos.pawn_key();
-  Entry* e = pos.this_thread()->pawnsTable[key];
+  Table& table = pos.this_thread()->pawnsTable;
+  Entry* e = table[key];
 
   if (e->key == key && !pos.pieces(SHOGI_PAWN))
+  {
+      table.hits++;
       return e;
+  }
+
+  // Shogi pawns are not part of the pawn key, so such entries are not shared
+  const bool share = !pos.pieces(SHOGI_PAWN);
+  if (share && Shared.probe(key, *e))
+  {
+      table.sharedHits++;
+      return e;
+  }
+
+  table.misses++;
 
   e->key = key;
   e->scores[WHITE] = evaluate<WHITE>(pos, e);
@@ -221,6 +237,9 @@ Entry* probe(const Position& pos) {
   e->asymmetry = popcount(  (e->passedPawns[WHITE]   | e->passedPawns[BLACK])
                           | (e->semiopenFiles[WHITE] ^ e->semiopenFiles[BLACK]));
 
+  if (share)
+      Shared.store(*e);
+
   return e;
 }
 
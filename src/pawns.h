@@ -77,6 +77,9 @@ struct Entry {
 };
 
 typedef HashTable<Entry, 16384> Table;
+typedef SharedHashTable<Entry> SharedTable;
+
+extern SharedTable Shared;
 
 void init();
 Entry* probe(const Position& pos);
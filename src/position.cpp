@@ -36,10 +36,6 @@
 
 using std::string;
 
-namespace PSQT {
-  extern Score psq[PIECE_NB][SQUARE_NB + 1];
-}
-
 namespace Zobrist {
 
   Key psq[PIECE_NB][SQUARE_NB];
@@ -53,37 +49,61 @@ namespace Zobrist {
 namespace {
 
 // min_attacker() is a helper function used by see_ge() to locate the least
-// valuable attacker for the side to move, remove the attacker we just found
-// from the bitboards and scan for new X-ray attacks behind it.
+// valuable attacker for the side to move, in the order of piece values of the
+// variant, remove the attacker we just found from the bitboards and scan for
+// new X-ray attacks behind it.
 
-template<int Pt>
-PieceType min_attacker(const Bitboard* byTypeBB, Square to, Bitboard stmAttackers,
-                       Bitboard& occupied, Bitboard& attackers) {
+PieceType min_attacker(const Position& pos, Square to, Bitboard stmAttackers,
+                       Bitboard& occupied, Bitboard& attackers, Square& from) {
 
-  Bitboard b = stmAttackers & byTypeBB[Pt];
-  if (!b)
-      return min_attacker<Pt + 1>(byTypeBB, to, stmAttackers, occupied, attackers);
+  const Variant* v = pos.variant();
 
-  occupied ^= lsb(b); // Remove the attacker from occupied
+  for (PieceType pt : v->seeOrder)
+  {
+      Bitboard b = stmAttackers & pos.pieces(pt);
+      if (!b)
+          continue;
 
-  // Add any X-ray attack behind the just removed piece. For instance with
-  // rooks in a8 and a7 attacking a1, after removing a7 we add rook in a8.
-  // Note that new added attackers can be of any color.
-  if (Pt == PAWN || Pt == BISHOP || Pt == QUEEN)
-      attackers |= attacks_bb<BISHOP>(to, occupied) & (byTypeBB[BISHOP] | byTypeBB[QUEEN]);
+      from = lsb(b);
 
-  if (Pt == ROOK || Pt == QUEEN)
-      attackers |= attacks_bb<ROOK>(to, occupied) & (byTypeBB[ROOK] | byTypeBB[QUEEN]);
+      if (pt == KING)
+          return KING; // No need to update bitboards: it is the last cycle
 
-  // X-ray may add already processed pieces because byTypeBB[] is constant: in
-  // the rook example, now attackers contains _again_ rook in a7, so remove it.
-  attackers &= occupied;
-  return (PieceType)Pt;
-}
+      occupied ^= from; // Remove the attacker from occupied
+
+      // Add any X-ray attack behind the just removed piece. For instance with
+      // rooks in a8 and a7 attacking a1, after removing a7 we add rook in a8.
+      // Note that new added attackers can be of any color.
+      for (int d = 0; d < 2; ++d)
+          if (PseudoAttacks[WHITE][d ? ROOK : BISHOP][to] & from)
+          {
+              Bitboard sliders = 0;
+              for (PieceType spt : v->sliders[d])
+                  sliders |= pos.pieces(spt);
+
+              b = (d ? attacks_bb<ROOK>(to, occupied) : attacks_bb<BISHOP>(to, occupied)) & sliders & ~attackers;
 
-template<>
-PieceType min_attacker<KING>(const Bitboard*, Square, Bitboard, Bitboard&, Bitboard&) {
-  return KING; // No need to update bitboards: it is the last cycle
+              // Sliders of fairy pieces may slide in some directions only
+              if (!v->fastAttacks)
+                  for (Bitboard x = b; x; )
+                  {
+                      Square s = pop_lsb(&x);
+                      if (!(attacks_bb(color_of(pos.piece_on(s)), type_of(pos.piece_on(s)), s, occupied) & to))
+                          b ^= s;
+                  }
+
+              attackers |= b;
+          }
+
+      // X-ray may add already processed pieces because the piece bitboards are
+      // constant: in the rook example, now attackers contains _again_ rook in
+      // a7, so remove it.
+      attackers &= occupied;
+      return pt;
+  }
+
+  assert(false);
+  return KING;
 }
 
 } // namespace
@@ -137,23 +157,12 @@ std::ostream& operator<<(std::ostream& os, const Position& pos) {
 // situations. Description of the algorithm in the following paper:
 // https://marcelk.net/2013-04-06/paper/upcoming-rep-v2.pdf
 
-// First and second hash functions for indexing the cuckoo tables
-#ifdef LARGEBOARDS
-inline int H1(Key h) { return h & 0x7fff; }
-inline int H2(Key h) { return (h >> 16) & 0x7fff; }
-#else
-inline int H1(Key h) { return h & 0x1fff; }
-inline int H2(Key h) { return (h >> 16) & 0x1fff; }
-#endif
+// The cuckoo tables of a variant hold the Zobrist hashes of the reversible moves
+// of its pieces, and the moves themselves. Their size is a power of two.
 
-// Cuckoo tables with Zobrist hashes of valid reversible moves, and the moves themselves
-#ifdef LARGEBOARDS
-Key cuckoo[65536];
-Move cuckooMove[65536];
-#else
-Key cuckoo[8192];
-Move cuckooMove[8192];
-#endif
+// First and second hash functions for indexing the cuckoo tables
+inline int H1(Key h, size_t size) { return h & (size - 1); }
+inline int H2(Key h, size_t size) { return (h >> 32) & (size - 1); }
 
 
 /// Position::init() initializes at startup the various arrays used to compute
@@ -194,35 +203,88 @@ void Position::init() {
           for (int n = 0; n < SQUARE_NB; ++n)
               Zobrist::inHand[make_piece(c, pt)][n] = rng.rand<Key>();
 
-  // Prepare the cuckoo tables
-  int count = 0;
+}
+
+
+/// Position::init() initializes the tables of a variant when it is loaded: the
+/// order of attackers for see_ge(), and the cuckoo tables with the moves of all
+/// its pieces but pawns, in both directions. Whether a move of the table can be
+/// played, e.g. by a piece moving only forwards, is verified when it is probed.
+
+void Position::init(Variant* v) {
+
+  std::set<PieceType> pieceTypes = v->pieceTypes;
+  for (PieceType pt : v->pieceTypes)
+      if (v->promotedPieceType[pt])
+          pieceTypes.insert(v->promotedPieceType[pt]);
+  pieceTypes.erase(PAWN);
+
+  Bitboard board = board_size_bb(v->maxFile, v->maxRank);
+  std::vector<std::pair<Key, Move>> moves;
+
   for (Color c = WHITE; c <= BLACK; ++c)
-      for (PieceType pt = KNIGHT; pt <= QUEEN || pt == KING; pt != QUEEN ? ++pt : pt = KING)
+      for (PieceType pt : pieceTypes)
       {
-      Piece pc = make_piece(c, pt);
-      for (Square s1 = SQ_A1; s1 <= SQ_MAX; ++s1)
-          for (Square s2 = Square(s1 + 1); s2 <= SQ_MAX; ++s2)
-              if (PseudoAttacks[WHITE][type_of(pc)][s1] & s2)
-              {
-                  Move move = make_move(s1, s2);
-                  Key key = Zobrist::psq[pc][s1] ^ Zobrist::psq[pc][s2] ^ Zobrist::side;
-                  int i = H1(key);
-                  while (true)
-                  {
-                      std::swap(cuckoo[i], key);
-                      std::swap(cuckooMove[i], move);
-                      if (move == 0)   // Arrived at empty slot ?
-                          break;
-                      i = (i == H1(key)) ? H2(key) : H1(key); // Push victim to alternative slot
-                  }
-                  count++;
-             }
+          Piece pc = make_piece(c, pt);
+          for (Bitboard b1 = board; b1; )
+          {
+              Square s1 = pop_lsb(&b1);
+              for (Square s2 = Square(s1 + 1); s2 <= SQ_MAX; ++s2)
+                  if (   (board & s2)
+                      && ((PseudoMoves[c][pt][s1] & s2) || (PseudoMoves[c][pt][s2] & s1)))
+                      moves.emplace_back(Zobrist::psq[pc][s1] ^ Zobrist::psq[pc][s2] ^ Zobrist::side,
+                                         make_move(s1, s2));
+          }
       }
-#ifdef LARGEBOARDS
-  assert(count == 9344);
-#else
-  assert(count == 3668);
-#endif
+
+  // Piece types by increasing value for the static exchange evaluation, with
+  // the king last, and the sliders for its X-ray attacks.
+  v->seeOrder.assign(pieceTypes.begin(), pieceTypes.end());
+  for (PieceType pt : v->promotionPieceTypes)
+      if (!pieceTypes.count(pt))
+          v->seeOrder.push_back(pt);
+  if (v->pieceTypes.count(PAWN))
+      v->seeOrder.push_back(PAWN);
+  std::stable_sort(v->seeOrder.begin(), v->seeOrder.end(), [](PieceType a, PieceType b) {
+      return (a == KING) < (b == KING) || ((a == KING) == (b == KING) && PieceValue[MG][a] < PieceValue[MG][b]);
+  });
+
+  for (PieceType pt : v->seeOrder)
+  {
+      if (AttackRiderTypes[pt] & RIDER_BISHOP)
+          v->sliders[0].push_back(pt);
+      if (AttackRiderTypes[pt] & RIDER_ROOK)
+          v->sliders[1].push_back(pt);
+  }
+
+  auto insert_all = [&](size_t size) {
+      v->cuckoo.assign(size, 0);
+      v->cuckooMove.assign(size, MOVE_NONE);
+
+      for (const auto& m : moves)
+      {
+          Key key = m.first;
+          Move move = m.second;
+          int i = H1(key, size);
+          for (size_t n = 0; move != MOVE_NONE; ++n)
+          {
+              if (n == size) // Caught in a cycle
+                  return false;
+              std::swap(v->cuckoo[i], key);
+              std::swap(v->cuckooMove[i], move);
+              i = (i == H1(key, size)) ? H2(key, size) : H1(key, size); // Push victim to alternative slot
+          }
+      }
+      return true;
+  };
+
+  // Keep the tables at most half full, and make them larger in the unlikely
+  // case that the moves cannot all be inserted.
+  size_t size = 1;
+  while (size < 2 * moves.size())
+      size *= 2;
+  while (!insert_all(size))
+      size *= 2;
 }
 
 
@@ -427,6 +489,8 @@ Position& Position::set(const Variant* v, const string& fenStr, bool isChess960,
   chess960 = isChess960;
   thisThread = th;
   set_state(st);
+  st->checkRun = bool(st->checkersBB);
+  repetitions[st->key & (RepetitionSlots - 1)] = st;
 
   assert(pos_is_ok());
 
@@ -468,16 +532,70 @@ void Position::set_check_info(StateInfo* si) const {
   si->blockersForKing[WHITE] = slider_blockers(pieces(BLACK), count<KING>(WHITE) ? square<KING>(WHITE) : SQ_NONE, si->pinners[BLACK]);
   si->blockersForKing[BLACK] = slider_blockers(pieces(WHITE), count<KING>(BLACK) ? square<KING>(BLACK) : SQ_NONE, si->pinners[WHITE]);
 
-  Square ksq = count<KING>(~sideToMove) ? square<KING>(~sideToMove) : SQ_NONE;
-
-  // For unused piece types, the check squares are left uninitialized
-  for (PieceType pt : piece_types())
-      si->checkSquares[pt] = ksq != SQ_NONE ? attacks_from(~sideToMove, pt, ksq) : 0;
-  si->checkSquares[KING]   = 0;
+  // The check squares of a piece type are computed by check_squares() when
+  // first needed, most piece types are never asked for at a given node.
+  si->checkSquaresSet = 0;
   si->shak = si->checkersBB & (byTypeBB[KNIGHT] | byTypeBB[ROOK] | byTypeBB[BERS]);
 }
 
 
+/// Position::record_state() links a new state to the most recent earlier state
+/// with the same key in the window of the n-fold rule, and adds it to the table
+/// of repetitions, which keeps the most recent state of each slot on the path
+/// from the root. Earlier states of a slot are linked by slotPrevious, so that
+/// a repetition is found in a few steps, however long the game is. It also
+/// counts the states in check, every second ply, to detect perpetual checks.
+
+void Position::record_state() {
+
+  StateInfo*& slot = repetitions[st->key & (RepetitionSlots - 1)];
+  int end = captures_to_hand() ? st->pliesFromNull : std::min(st->rule50, st->pliesFromNull);
+
+  st->ply = st->previous->ply + 1;
+  st->checkRun = !st->checkersBB ? 0 : st->previous->previous ? st->previous->previous->checkRun + 1 : 1;
+  st->repetition = nullptr;
+
+  for (StateInfo* stp = slot; stp && st->ply - stp->ply <= end; stp = stp->slotPrevious)
+      if (stp->key == st->key)
+      {
+          st->repetition = stp;
+          break;
+      }
+
+  st->slotPrevious = slot;
+  slot = st;
+}
+
+
+/// Position::set_repetitions() fills the table of repetitions with the states
+/// since the last null move. It is needed when the states of the moves leading
+/// to the position are attached to it after set(), see ThreadPool::start_thinking().
+
+void Position::set_repetitions() {
+
+  std::fill_n(repetitions, RepetitionSlots, nullptr);
+
+  StateInfo* stp = st;
+  for (int i = 0; stp && i <= st->pliesFromNull; ++i, stp = stp->previous)
+  {
+      StateInfo*& slot = repetitions[stp->key & (RepetitionSlots - 1)];
+      if (!slot)
+          slot = stp;
+  }
+}
+
+
+/// Position::set_check_squares() computes the check squares of all piece types,
+/// so that the state is no longer written by check_squares(). It is needed when
+/// a state is shared by threads, see ThreadPool::start_thinking().
+
+void Position::set_check_squares() const {
+
+  for (PieceType pt = PAWN; pt <= KING; ++pt)
+      check_squares(pt);
+}
+
+
 /// Position::set_state() computes the hash keys of the position, and other
 /// data that once computed is updated incrementally as moves are made.
 /// The function is only used when a new position is set up, and to verify
@@ -498,14 +616,14 @@ void Position::set_state(StateInfo* si) const {
       Square s = pop_lsb(&b);
       Piece pc = piece_on(s);
       si->key ^= Zobrist::psq[pc][s];
-      si->psq += PSQT::psq[pc][s];
+      si->psq += var->psq[pc][s];
   }
   // pieces in hand
   if (piece_drops())
   {
       for (Color c = WHITE; c <= BLACK; ++c)
           for (PieceType pt = PAWN; pt <= KING; ++pt)
-              si->psq += PSQT::psq[make_piece(c, pt)][SQ_NONE] * pieceCountInHand[c][pt];
+              si->psq += var->psq[make_piece(c, pt)][SQ_NONE] * pieceCountInHand[c][pt];
   }
 
   if (si->epSquare != SQ_NONE)
@@ -655,10 +773,23 @@ Bitboard Position::slider_blockers(Bitboard sliders, Square s, Bitboard& pinners
   if (s == SQ_NONE || !sliders)
       return blockers;
 
-  // Snipers are sliders that attack 's' when a piece is removed
-  Bitboard snipers =   sliders
-                    &  attackers_to(s, 0)
-                    & ~attackers_to(s);
+  // Snipers are sliders that attack 's' when a piece is removed. It is enough
+  // to take all sliders that attack 's' on an empty board with their sliding
+  // component, those attacking it already have no piece in between. The ones
+  // attacking it also by a leap are skipped, they never are blocked.
+  Bitboard snipers = 0;
+
+  if (var->fastAttacks)
+      snipers =  (PseudoAttacks[WHITE][ROOK  ][s] & (pieces(ROOK, QUEEN) | pieces(CHANCELLOR)))
+               | (PseudoAttacks[WHITE][BISHOP][s] & (pieces(BISHOP, QUEEN) | pieces(ARCHBISHOP)));
+  else
+      for (PieceType pt : piece_types())
+          if (AttackRiderTypes[pt])
+              for (Color c : { WHITE, BLACK })
+                  snipers |=  PseudoAttacks[~c][pt][s] & ~LeaperAttacks[~c][pt][s]
+                            & pieces(c, pt);
+
+  snipers &= sliders;
 
   while (snipers)
   {
@@ -681,6 +812,15 @@ Bitboard Position::slider_blockers(Bitboard sliders, Square s, Bitboard& pinners
 
 Bitboard Position::attackers_to(Square s, Bitboard occupied, Color c) const {
 
+  // Use a faster version for variants restricted to pieces with chess-like attacks
+  if (var->fastAttacks)
+      return  (  (LeaperAttacks[~c][PAWN][s]      & pieces(PAWN))
+               | (LeaperAttacks[~c][KNIGHT][s]    & (pieces(KNIGHT, ARCHBISHOP) | pieces(CHANCELLOR)))
+               | (attacks_bb<  ROOK>(s, occupied) & (pieces(ROOK, QUEEN) | pieces(CHANCELLOR)))
+               | (attacks_bb<BISHOP>(s, occupied) & (pieces(BISHOP, QUEEN) | pieces(ARCHBISHOP)))
+               | (LeaperAttacks[~c][KING][s]      & pieces(KING, COMMONER)))
+            & pieces(c);
+
   Bitboard b = 0;
   for (PieceType pt : piece_types())
       b |= attacks_bb(~c, pt, s, occupied) & pieces(c, pt);
@@ -771,6 +911,12 @@ bool Position::legal(Move m) const {
   if (immobility_illegal() && (type_of(m) == DROP || type_of(m) == NORMAL) && !(moves_bb(us, type_of(moved_piece(m)), to, 0) & board_bb()))
       return false;
 
+  // Dropping a piece can only block attacks, there are no hoppers, so when
+  // not in check a drop cannot leave our king attacked. A dropped king still
+  // must not land on an attacked square.
+  if (type_of(m) == DROP && !checkers() && type_of(moved_piece(m)) != KING)
+      return true;
+
   // En passant captures are a tricky special case. Because they are rather
   // uncommon, we do it simply by testing whether the king is attacked after
   // the move is made.
@@ -894,7 +1040,7 @@ bool Position::gives_check(Move m) const {
       return false;
 
   // Is there a direct check?
-  if (type_of(m) != PROMOTION && type_of(m) != PIECE_PROMOTION && type_of(m) != PIECE_DEMOTION && (st->checkSquares[type_of(moved_piece(m))] & to))
+  if (type_of(m) != PROMOTION && type_of(m) != PIECE_PROMOTION && type_of(m) != PIECE_DEMOTION && (check_squares(type_of(moved_piece(m))) & to))
       return true;
 
   // Is there a discovered check?
@@ -965,6 +1111,12 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   newSt.previous = st;
   st = &newSt;
 
+  // The accumulator of the NNUE evaluation is computed from the previous one
+  // and the pieces changed by the move, when needed.
+  Eval::NNUE::DirtyPiece& dp = st->dirtyPiece;
+  dp.dirtyNum = 0;
+  st->accumulator.computed = false;
+
   // Increment ply counters. In particular, rule50 will be reset to zero later on
   // in case of a capture or a pawn move.
   ++gamePly;
@@ -998,8 +1150,12 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
       Square rfrom, rto;
       do_castling<true>(us, from, to, rfrom, rto);
+      dp.add(pc, from, false);
+      dp.add(pc, to, true);
+      dp.add(captured, rfrom, false);
+      dp.add(captured, rto, true);
 
-      st->psq += PSQT::psq[captured][rto] - PSQT::psq[captured][rfrom];
+      st->psq += var->psq[captured][rto] - var->psq[captured][rfrom];
       k ^= Zobrist::psq[captured][rfrom] ^ Zobrist::psq[captured][rto];
       captured = NO_PIECE;
   }
@@ -1032,6 +1188,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
       // Update board and piece lists
       remove_piece(captured, capsq);
+      dp.add(captured, capsq, false);
       if (captures_to_hand())
       {
           st->capturedpromoted = is_promoted(to);
@@ -1039,7 +1196,8 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
                              : unpromotedCaptured ? ~unpromotedCaptured
                                                   : make_piece(~color_of(captured), PAWN);
           add_to_hand(color_of(pieceToHand), type_of(pieceToHand));
-          st->psq += PSQT::psq[pieceToHand][SQ_NONE];
+          dp.add(pieceToHand, SQ_NONE, true, pieceCountInHand[color_of(pieceToHand)][type_of(pieceToHand)] - 1);
+          st->psq += var->psq[pieceToHand][SQ_NONE];
           k ^=  Zobrist::inHand[pieceToHand][pieceCountInHand[color_of(pieceToHand)][type_of(pieceToHand)] - 1]
               ^ Zobrist::inHand[pieceToHand][pieceCountInHand[color_of(pieceToHand)][type_of(pieceToHand)]];
           promotedPieces -= to;
@@ -1052,7 +1210,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       prefetch(thisThread->materialTable[st->materialKey]);
 
       // Update incremental scores
-      st->psq -= PSQT::psq[captured][capsq];
+      st->psq -= var->psq[captured][capsq];
 
       // Reset rule 50 counter
       st->rule50 = 0;
@@ -1087,6 +1245,8 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   // Move the piece. The tricky Chess960 castling is handled earlier
   if (type_of(m) == DROP)
   {
+      dp.add(make_piece(us, in_hand_piece_type(m)), SQ_NONE, false, pieceCountInHand[us][in_hand_piece_type(m)] - 1);
+      dp.add(pc, to, true);
       drop_piece(make_piece(us, in_hand_piece_type(m)), pc, to);
       st->materialKey ^= Zobrist::psq[pc][pieceCount[pc]-1];
       if (type_of(pc) != PAWN)
@@ -1111,7 +1271,11 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       }
   }
   else if (type_of(m) != CASTLING)
+  {
+      dp.add(pc, from, false);
+      dp.add(pc, to, true);
       move_piece(pc, from, to);
+  }
 
   // If the moving piece is a pawn do some special extra work
   if (type_of(pc) == PAWN)
@@ -1134,6 +1298,8 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
           remove_piece(pc, to);
           put_piece(promotion, to);
+          dp.add(pc, to, false);
+          dp.add(promotion, to, true);
           if (captures_to_hand() && !drop_loop())
               promotedPieces = promotedPieces | to;
 
@@ -1144,7 +1310,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
                             ^ Zobrist::psq[pc][pieceCount[pc]];
 
           // Update incremental score
-          st->psq += PSQT::psq[promotion][to] - PSQT::psq[pc][to];
+          st->psq += var->psq[promotion][to] - var->psq[pc][to];
 
           // Update material
           st->nonPawnMaterial[us] += PieceValue[MG][promotion];
@@ -1166,6 +1332,8 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
       remove_piece(pc, to);
       put_piece(promotion, to);
+      dp.add(pc, to, false);
+      dp.add(promotion, to, true);
       promotedPieces |= to;
       unpromotedBoard[to] = pc;
 
@@ -1175,7 +1343,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
                         ^ Zobrist::psq[pc][pieceCount[pc]];
 
       // Update incremental score
-      st->psq += PSQT::psq[promotion][to] - PSQT::psq[pc][to];
+      st->psq += var->psq[promotion][to] - var->psq[pc][to];
 
       // Update material
       st->nonPawnMaterial[us] += PieceValue[MG][promotion] - PieceValue[MG][pc];
@@ -1186,6 +1354,8 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
       remove_piece(pc, to);
       put_piece(demotion, to);
+      dp.add(pc, to, false);
+      dp.add(demotion, to, true);
       promotedPieces ^= from;
       unpromotedBoard[from] = NO_PIECE;
 
@@ -1195,14 +1365,14 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
                         ^ Zobrist::psq[pc][pieceCount[pc]];
 
       // Update incremental score
-      st->psq += PSQT::psq[demotion][to] - PSQT::psq[pc][to];
+      st->psq += var->psq[demotion][to] - var->psq[pc][to];
 
       // Update material
       st->nonPawnMaterial[us] += PieceValue[MG][demotion] - PieceValue[MG][pc];
   }
 
   // Update incremental scores
-  st->psq += PSQT::psq[pc][to] - PSQT::psq[pc][from];
+  st->psq += var->psq[pc][to] - var->psq[pc][from];
 
   // Set capture piece
   st->capturedPiece = captured;
@@ -1235,6 +1405,8 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   // Update king attacks used for fast check detection
   set_check_info(st);
 
+  record_state();
+
   assert(pos_is_ok());
 }
 
@@ -1340,6 +1512,7 @@ void Position::undo_move(Move m) {
   }
 
   // Finally point our state pointer back to the previous state
+  repetitions[st->key & (RepetitionSlots - 1)] = st->slotPrevious;
   st = st->previous;
   --gamePly;
 
@@ -1376,9 +1549,12 @@ void Position::do_null_move(StateInfo& newSt) {
   assert(!checkers());
   assert(&newSt != st);
 
-  std::memcpy(&newSt, st, sizeof(StateInfo));
+  // The data computed by set_check_info() is not copied
+  std::memcpy(&newSt, st, offsetof(StateInfo, checkSquaresSet));
   newSt.previous = st;
   st = &newSt;
+  st->dirtyPiece.dirtyNum = 0;
+  st->accumulator.computed = false;
 
   if (st->epSquare != SQ_NONE)
   {
@@ -1396,6 +1572,8 @@ void Position::do_null_move(StateInfo& newSt) {
 
   set_check_info(st);
 
+  record_state();
+
   assert(pos_is_ok());
 }
 
@@ -1403,6 +1581,7 @@ void Position::undo_null_move() {
 
   assert(!checkers());
 
+  repetitions[st->key & (RepetitionSlots - 1)] = st->slotPrevious;
   st = st->previous;
   sideToMove = ~sideToMove;
 }
@@ -1449,12 +1628,14 @@ bool Position::see_ge(Move m, Value threshold) const {
 
   assert(is_ok(m));
 
+  thisThread->stats.seeCalls++;
+
   // Only deal with normal moves, assume others pass a simple see
   if (type_of(m) != NORMAL && type_of(m) != DROP && type_of(m) != PIECE_PROMOTION)
       return VALUE_ZERO >= threshold;
 
   Bitboard stmAttackers;
-  Square from = from_sq(m), to = to_sq(m);
+  Square from = from_sq(m), to = to_sq(m), victimSq = from;
   PieceType nextVictim = type_of(m) == DROP ? dropped_piece_type(m) : type_of(piece_on(from));
   Color us = type_of(m) == DROP ? sideToMove : color_of(piece_on(from));
   Color stm = ~us; // First consider opponent's move
@@ -1474,16 +1655,25 @@ bool Position::see_ge(Move m, Value threshold) const {
               && count<ALL_PIECES>(~sideToMove) == 1)))
       return extinction_value() < VALUE_ZERO;
 
+  // When captured pieces go to the hand, a promoted piece is only worth its
+  // unpromoted type there, so capturing it gains less than its value.
+  auto value = [&](PieceType pt, Square s) {
+      if (!captures_to_hand() || (type_of(m) == DROP && s == from) || !is_promoted(s))
+          return PieceValue[MG][pt];
+      Piece unpromoted = unpromoted_piece_on(s);
+      return (PieceValue[MG][pt] + PieceValue[MG][unpromoted ? type_of(unpromoted) : PAWN]) / 2;
+  };
+
   // The opponent may be able to recapture so this is the best result
   // we can hope for.
-  balance = PieceValue[MG][piece_on(to)] - threshold;
+  balance = (piece_on(to) ? value(type_of(piece_on(to)), to) : VALUE_ZERO) - threshold;
 
   if (balance < VALUE_ZERO)
       return false;
 
   // Now assume the worst possible result: that the opponent can
   // capture our piece for free.
-  balance -= PieceValue[MG][nextVictim];
+  balance -= value(nextVictim, from);
 
   // If it is enough (like in PxQ) then return immediately. Note that
   // in case nextVictim == KING we always return here, this is ok
@@ -1492,9 +1682,15 @@ bool Position::see_ge(Move m, Value threshold) const {
       return true;
 
   // Find all attackers to the destination square, with the moving piece
-  // removed, but possibly an X-ray attacker added behind it.
+  // removed, but possibly an X-ray attacker added behind it. Most often the
+  // opponent has none, and then our attackers are not needed.
   Bitboard occupied = type_of(m) == DROP ? pieces() ^ to : pieces() ^ from ^ to;
-  Bitboard attackers = attackers_to(to, occupied) & occupied;
+  Bitboard attackers = attackers_to(to, occupied, stm) & occupied;
+
+  if (!attackers)
+      return true;
+
+  attackers |= attackers_to(to, occupied, us) & occupied;
 
   while (true)
   {
@@ -1511,7 +1707,7 @@ bool Position::see_ge(Move m, Value threshold) const {
 
       // Locate and remove the next least valuable attacker, and add to
       // the bitboard 'attackers' the possibly X-ray attackers behind it.
-      nextVictim = min_attacker<PAWN>(byTypeBB, to, stmAttackers, occupied, attackers);
+      nextVictim = min_attacker(*this, to, stmAttackers, occupied, attackers, victimSq);
 
       stm = ~stm; // Switch side to move
 
@@ -1522,7 +1718,7 @@ bool Position::see_ge(Move m, Value threshold) const {
       //
       assert(balance < VALUE_ZERO);
 
-      balance = -balance - 1 - PieceValue[MG][nextVictim];
+      balance = -balance - 1 - value(nextVictim, victimSq);
 
       // If balance is still non-negative after giving away nextVictim then we
       // win. The only thing to be careful about it is that we should revert
@@ -1559,18 +1755,18 @@ bool Position::is_optional_game_end(Value& result, int ply) const {
       if (end < 4)
           return false;
 
-      StateInfo* stp = st->previous->previous;
+      // Number of states in check every second ply, from the fourth ply back
+      int checkRun = st->previous->previous->previous->previous->checkRun;
       int cnt = 0;
-      bool perpetual = true;
 
-      for (int i = 4; i <= end; i += 2)
+      for (StateInfo* stp = st->repetition; stp && st->ply - stp->ply <= end; stp = stp->repetition)
       {
-          stp = stp->previous->previous;
-          perpetual &= bool(stp->checkersBB);
+          int i = st->ply - stp->ply;
+          bool perpetual = 2 * checkRun >= i - 2;
 
           // Return a draw score if a position repeats once earlier but strictly
           // after the root, or repeats twice before or at the root.
-          if (   stp->key == st->key
+          if (   i >= 4
               && ++cnt + 1 == (ply > i ? 2 : n_fold_rule()))
           {
               result = convert_mate_value(  var->perpetualCheckIllegal && perpetual ? VALUE_MATE
@@ -1666,22 +1862,15 @@ bool Position::has_repeated() const {
     StateInfo* stc = st;
     while (true)
     {
-        int i = 4, end = std::min(stc->rule50, stc->pliesFromNull);
+        int end = std::min(stc->rule50, stc->pliesFromNull);
 
-        if (end < i)
+        if (end < 4)
             return false;
 
-        StateInfo* stp = stc->previous->previous;
-
-        do {
-            stp = stp->previous->previous;
-
-            if (stp->key == stc->key)
+        for (StateInfo* stp = stc->repetition; stp && stc->ply - stp->ply <= end; stp = stp->repetition)
+            if (stc->ply - stp->ply >= 4)
                 return true;
 
-            i += 2;
-        } while (i <= end);
-
         stc = stc->previous;
     }
 }
@@ -1699,6 +1888,7 @@ bool Position::has_game_cycle(int ply) const {
   if (end < 3 || var->nFoldValue != VALUE_DRAW)
     return false;
 
+  const std::vector<Key>& cuckoo = var->cuckoo;
   Key originalKey = st->key;
   StateInfo* stp = st->previous;
 
@@ -1707,31 +1897,38 @@ bool Position::has_game_cycle(int ply) const {
       stp = stp->previous->previous;
 
       Key moveKey = originalKey ^ stp->key;
-      if (   (j = H1(moveKey), cuckoo[j] == moveKey)
-          || (j = H2(moveKey), cuckoo[j] == moveKey))
+      if (   (j = H1(moveKey, cuckoo.size()), cuckoo[j] == moveKey)
+          || (j = H2(moveKey, cuckoo.size()), cuckoo[j] == moveKey))
       {
-          Move move = cuckooMove[j];
-          Square s1 = from_sq(move);
-          Square s2 = to_sq(move);
+          Square s1 = from_sq(var->cuckooMove[j]);
+          Square s2 = to_sq(var->cuckooMove[j]);
+
+          // In the cuckoo table, both moves Rc1c5 and Rc5c1 are stored in the same
+          // location. We select the legal one by reversing the move if necessary,
+          // and verify that the piece can make it, which covers the path of sliders.
+          if (empty(s1))
+              std::swap(s1, s2);
 
-          if (!(between_bb(s1, s2) & pieces()))
+          Piece pc = piece_on(s1);
+
+          if (pc && (moves_from(color_of(pc), type_of(pc), s1) & s2))
           {
-              // In the cuckoo table, both moves Rc1c5 and Rc5c1 are stored in the same
-              // location. We select the legal one by reversing the move variable if necessary.
-              if (empty(s1))
-                  move = make_move(s2, s1);
+              // A repetition is not a draw if a player may be giving perpetual check
+              if (var->perpetualCheckIllegal)
+              {
+                  bool check = false;
+                  for (StateInfo* s = st; s != stp->previous; s = s->previous)
+                      check |= bool(s->checkersBB);
+                  if (check)
+                      continue;
+              }
 
               if (ply > i)
                   return true;
 
               // For repetitions before or at the root, require one more
-              StateInfo* next_stp = stp;
-              for (int k = i + 2; k <= end; k += 2)
-              {
-                  next_stp = next_stp->previous->previous;
-                  if (next_stp->key == stp->key)
-                     return true;
-              }
+              if (stp->repetition && st->ply - stp->repetition->ply <= end)
+                  return true;
           }
       }
   }
@@ -1813,7 +2010,8 @@ bool Position::pos_is_ok() const {
 
   StateInfo si = *st;
   set_state(&si);
-  if (std::memcmp(&si, st, sizeof(StateInfo)))
+  si.checkSquaresSet = st->checkSquaresSet; // The check squares are computed lazily
+  if (std::memcmp(&si, st, offsetof(StateInfo, checkSquares)))
       assert(0 && "pos_is_ok: State");
 
   for (Color c = WHITE; c <= BLACK; ++c)
@@ -28,6 +28,7 @@
 #include <functional>
 
 #include "bitboard.h"
+#include "nnue.h"
 #include "types.h"
 #include "variant.h"
 
@@ -55,13 +56,28 @@ struct StateInfo {
   Piece      capturedPiece;
   Piece      unpromotedCapturedPiece;
   StateInfo* previous;
+  bool       capturedpromoted;
+  bool       shak;
+
+  // Computed by set_check_info(), the check squares only when first needed
+  uint32_t   checkSquaresSet;
   Bitboard   blockersForKing[COLOR_NB];
   Bitboard   pinners[COLOR_NB];
   Bitboard   checkSquares[PIECE_TYPE_NB];
-  bool       capturedpromoted;
-  bool       shak;
+
+  // Set by record_state(), to find repetitions without walking the whole game
+  int        ply;
+  int        checkRun;
+  StateInfo* repetition;
+  StateInfo* slotPrevious;
+
+  // Used by the NNUE evaluation, the accumulator only when first needed
+  Eval::NNUE::DirtyPiece  dirtyPiece;
+  Eval::NNUE::Accumulator accumulator;
 };
 
+static_assert(PIECE_TYPE_NB <= 32, "checkSquaresSet has too few bits");
+
 /// A list to keep track of the position states along the setup moves (from the
 /// start position to the position just before the search starts). Needed by
 /// 'draw by repetition' detection. Use a std::deque because pointers to
@@ -78,6 +94,7 @@ class Thread;
 class Position {
 public:
   static void init();
+  static void init(Variant* v);
 
   Position() = default;
   Position(const Position&) = delete;
@@ -118,6 +135,8 @@ public:
   bool drop_on_top() const;
   Bitboard drop_region(Color c) const;
   Bitboard drop_region(Color c, PieceType pt) const;
+  Bitboard drop_targets(Color c) const;
+  Bitboard drop_region(Color c, PieceType pt, Bitboard targets) const;
   bool sittuyin_rook_drop() const;
   bool drop_opposite_colored_bishop() const;
   bool drop_promoted() const;
@@ -195,6 +214,7 @@ public:
   bool pawn_passed(Color c, Square s) const;
   bool opposite_bishops() const;
   bool is_promoted(Square s) const;
+  Bitboard promoted_pieces() const;
 
   // Doing and undoing moves
   void do_move(Move m, StateInfo& newSt);
@@ -217,12 +237,15 @@ public:
   int game_ply() const;
   bool is_chess960() const;
   Thread* this_thread() const;
+  StateInfo* state() const;
   bool is_immediate_game_end() const;
   bool is_game_end(Value& result, int ply = 0) const;
   bool is_optional_game_end(Value& result, int ply = 0) const;
   bool is_immediate_game_end(Value& result, int ply = 0) const;
   bool has_game_cycle(int ply) const;
   bool has_repeated() const;
+  void set_repetitions();
+  void set_check_squares() const;
   int rule50_count() const;
   Score psq_score() const;
   Value non_pawn_material(Color c) const;
@@ -237,6 +260,7 @@ private:
   void set_castling_right(Color c, Square rfrom);
   void set_state(StateInfo* si) const;
   void set_check_info(StateInfo* si) const;
+  void record_state();
 
   // Other helpers
   void put_piece(Piece pc, Square s);
@@ -260,6 +284,8 @@ private:
   Color sideToMove;
   Thread* thisThread;
   StateInfo* st;
+  static constexpr int RepetitionSlots = 256;
+  StateInfo* repetitions[RepetitionSlots]; // Most recent state of each slot, by key
 
   // variant-specific
   const Variant* var;
@@ -414,12 +440,26 @@ inline Bitboard Position::drop_region(Color c) const {
   return c == WHITE ? var->whiteDropRegion : var->blackDropRegion;
 }
 
-inline Bitboard Position::drop_region(Color c, PieceType pt) const {
+/// Position::drop_targets() returns the squares drops of any piece type are
+/// restricted to, and drop_region(c, pt, targets) further restricts them by the
+/// rules specific to the given piece type. This allows the move generator to
+/// compute the common part only once for all the piece types in hand.
+
+inline Bitboard Position::drop_targets(Color c) const {
   Bitboard b = drop_region(c) & board_bb();
 
   // Connect4-style drops
   if (drop_on_top())
       b &= shift<NORTH>(pieces()) | Rank1BB;
+
+  return b;
+}
+
+inline Bitboard Position::drop_region(Color c, PieceType pt) const {
+  return drop_region(c, pt, drop_targets(c));
+}
+
+inline Bitboard Position::drop_region(Color c, PieceType pt, Bitboard b) const {
   // Pawns on back ranks
   if (pt == PAWN)
   {
@@ -429,9 +469,8 @@ inline Bitboard Position::drop_region(Color c, PieceType pt) const {
   }
   // Doubled shogi pawns
   if (pt == SHOGI_PAWN && !shogi_doubled_pawn())
-      for (File f = FILE_A; f <= max_file(); ++f)
-          if (file_bb(f) & pieces(c, pt))
-              b &= ~file_bb(f);
+      for (Bitboard pawns = pieces(c, pt); pawns; )
+          b &= ~file_bb(pop_lsb(&pawns));
   // Sittuyin rook drops
   if (pt == ROOK && sittuyin_rook_drop())
       b &= rank_bb(relative_rank(c, RANK_1, max_rank()));
@@ -695,6 +734,13 @@ inline Bitboard Position::blockers_for_king(Color c) const {
 }
 
 inline Bitboard Position::check_squares(PieceType pt) const {
+
+  if (!(st->checkSquaresSet & (1U << pt)))
+  {
+      st->checkSquaresSet |= 1U << pt;
+      st->checkSquares[pt] = pt != KING && count<KING>(~sideToMove)
+                            ? attacks_from(~sideToMove, pt, square<KING>(~sideToMove)) : 0;
+  }
   return st->checkSquares[pt];
 }
 
@@ -749,6 +795,10 @@ inline bool Position::is_promoted(Square s) const {
   return promotedPieces & s;
 }
 
+inline Bitboard Position::promoted_pieces() const {
+  return promotedPieces;
+}
+
 inline bool Position::is_chess960() const {
   return chess960;
 }
@@ -772,6 +822,10 @@ inline Thread* Position::this_thread() const {
   return thisThread;
 }
 
+inline StateInfo* Position::state() const {
+  return st;
+}
+
 inline void Position::put_piece(Piece pc, Square s) {
 
   board[s] = pc;
@@ -110,12 +110,13 @@ constexpr Score KingBonus[RANK_NB][int(FILE_NB) / 2] = {
 
 #undef S
 
-Score psq[PIECE_NB][SQUARE_NB + 1];
+// init() initializes the piece-square table of a variant: the white halves of
+// the tables are copied from Bonus[] adding the piece value, then the black halves
+// of the tables are initialized by flipping and changing the sign of the white
+// scores. It is called once for each variant when it is registered.
+void init(Variant* v) {
 
-// init() initializes piece-square tables: the white halves of the tables are
-// copied from Bonus[] adding the piece value, then the black halves of the
-// tables are initialized by flipping and changing the sign of the white scores.
-void init(const Variant* v) {
+  Score (&psq)[PIECE_NB][SQUARE_NB + 1] = v->psq;
 
   for (PieceType pt = PAWN; pt <= KING; ++pt)
   {
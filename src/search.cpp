@@ -25,6 +25,7 @@
 #include <iostream>
 #include <sstream>
 
+#include "cluster.h"
 #include "evaluate.h"
 #include "misc.h"
 #include "movegen.h"
@@ -61,14 +62,20 @@ namespace {
   // Different node types, used as a template parameter
   enum NodeType { NonPV, PV };
 
+  // Depth distribution schemes of the helper threads
+  enum SmpScheme { SMP_SKIP_BLOCKS, SMP_ALTERNATE, SMP_NONE };
+
   // Sizes and phases of the skip-blocks, used for distributing search depths across the threads
   constexpr int SkipSize[]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
   constexpr int SkipPhase[] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
 
+  // Search parameters of the current variant, see Search::init()
+  SearchParams Params;
+
   // Razor and futility margins
-  constexpr int RazorMargin[] = {0, 590, 604};
+  int RazorMargin[3];
   Value futility_margin(Depth d, bool improving) {
-    return Value((175 - 50 * improving) * d / ONE_PLY);
+    return Value((Params.futilityMargin - Params.futilityImproving * improving) * d / ONE_PLY);
   }
 
   // Futility and reductions lookup tables, initialized at startup
@@ -116,44 +123,118 @@ namespace {
           : pos.gives_check(move);
   }
 
+  // Perft hash table, shared by all threads. An entry stores the number of
+  // leaf nodes of a position at a given remaining depth. The key is saved
+  // xored with the count, so that entries torn by concurrent writes fail
+  // the verification and are just ignored.
+  struct PerftEntry {
+    Key keyXorCnt;
+    uint64_t cnt;
+  };
+
+  std::vector<PerftEntry> PerftTable;
+
+  // Root moves of a perft, distributed across the threads
+  std::vector<Move> PerftMoves;
+  std::vector<uint64_t> PerftCounts;
+  std::atomic<size_t> PerftNext;
+
+  // perft_key() adds the remaining depth and the promoted pieces to the key of
+  // the position. The latter are not part of the Zobrist key, but change the
+  // moves after they are captured to the hand or demoted.
+  Key perft_key(const Position& pos, Depth depth) {
+
+    Key key = pos.key() ^ (uint64_t(depth / ONE_PLY) * 0x9E3779B97F4A7C15ULL);
+
+    for (Bitboard b = pos.promoted_pieces(); b; )
+    {
+        Square s = pop_lsb(&b);
+        uint64_t x = (uint64_t(pos.unpromoted_piece_on(s)) << 16 | s) * 0xBF58476D1CE4E5B9ULL;
+        key ^= (x ^ (x >> 31)) * 0x94D049BB133111EBULL;
+    }
+
+    return key;
+  }
+
+  PerftEntry* perft_entry(Key key) {
+    return &PerftTable[(uint32_t(key) * uint64_t(PerftTable.size())) >> 32];
+  }
+
   // perft() is our utility to verify move generation. All the leaf nodes up
   // to the given depth are generated and counted, and the sum is returned.
-  template<bool Root>
   uint64_t perft(Position& pos, Depth depth) {
 
     StateInfo st;
-    uint64_t cnt, nodes = 0;
+    uint64_t cnt = 0;
     const bool leaf = (depth == 2 * ONE_PLY);
+    const Key key = PerftTable.empty() ? 0 : perft_key(pos, depth);
+    PerftEntry* pe = PerftTable.empty() ? nullptr : perft_entry(key);
+
+    if (pe && (pe->keyXorCnt ^ pe->cnt) == key)
+        return pe->cnt;
 
     for (const auto& m : MoveList<LEGAL>(pos))
     {
-        if (Root && depth <= ONE_PLY)
-            cnt = 1, nodes++;
+        pos.do_move(m, st);
+        cnt += leaf ? MoveList<LEGAL>(pos).size() : perft(pos, depth - ONE_PLY);
+        pos.undo_move(m);
+    }
+
+    if (pe)
+        pe->keyXorCnt = key ^ cnt, pe->cnt = cnt;
+
+    return cnt;
+  }
+
+  // perft_root() counts the leaf nodes below the root moves, taking the next
+  // unclaimed root move until all of them are done. It is run by all the
+  // threads taking part in a perft.
+  void perft_root(Position& pos, Depth depth) {
+
+    StateInfo st;
+    size_t idx;
+
+    while ((idx = PerftNext++) < PerftMoves.size())
+    {
+        if (depth <= ONE_PLY)
+            PerftCounts[idx] = 1;
         else
         {
-            pos.do_move(m, st);
-            cnt = leaf ? MoveList<LEGAL>(pos).size() : perft<false>(pos, depth - ONE_PLY);
-            nodes += cnt;
-            pos.undo_move(m);
+            pos.do_move(PerftMoves[idx], st);
+            PerftCounts[idx] = depth == 2 * ONE_PLY ? MoveList<LEGAL>(pos).size()
+                                                    : perft(pos, depth - ONE_PLY);
+            pos.undo_move(PerftMoves[idx]);
         }
-        if (Root)
-            sync_cout << UCI::move(pos, m) << ": " << cnt << sync_endl;
     }
-    return nodes;
   }
 
 } // namespace
 
 
 /// Search::init() is called at startup to initialize various lookup tables
+/// with the default search parameters, and before each search with those of
+/// the variant to be searched. The tables are only rebuilt if they changed.
 
-void Search::init() {
+void Search::init() { init(SearchParams()); }
+
+void Search::init(const SearchParams& params) {
+
+  static bool initialized = false;
+
+  if (initialized && params == Params)
+      return;
+
+  initialized = true;
+  Params = params;
+  RazorMargin[0] = 0;
+  RazorMargin[1] = params.razorMargin1;
+  RazorMargin[2] = params.razorMargin2;
 
   for (int imp = 0; imp <= 1; ++imp)
       for (int d = 1; d < 64; ++d)
           for (int mc = 1; mc < 64; ++mc)
           {
-              double r = log(d) * log(mc) / 1.95;
+              double r = log(d) * log(mc) / (params.reductionDivisor / 100.0);
 
               Reductions[NonPV][imp][d][mc] = int(std::round(r));
               Reductions[PV][imp][d][mc] = std::max(Reductions[NonPV][imp][d][mc] - 1, 0);
@@ -177,9 +258,14 @@ void Search::clear() {
 
   Threads.main()->wait_for_search_finished();
 
+  TimePoint elapsed = now();
+
   Time.availableNodes = 0;
-  TT.clear();
-  Threads.clear();
+  Threads.clear(); // Also clears the transposition table
+
+  if (Options["Search Stats"])
+      sync_cout << "info string Cleared hash and " << Threads.size() << " threads in "
+                << now() - elapsed << " ms" << sync_endl;
 }
 
 
@@ -190,24 +276,58 @@ void MainThread::search() {
 
   if (Limits.perft)
   {
-      nodes = perft<true>(rootPos, Limits.perft * ONE_PLY);
-      sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
+      // Spread the root moves over the requested number of threads
+      size_t threadCnt = Limits.perftThreads ? std::min(size_t(Limits.perftThreads), Threads.size())
+                                             : Threads.size();
+
+      PerftTable.assign(size_t(Limits.perftHash) * 1024 * 1024 / sizeof(PerftEntry), PerftEntry());
+      PerftMoves.clear();
+      for (const auto& m : MoveList<LEGAL>(rootPos))
+          PerftMoves.push_back(m);
+      PerftCounts.assign(PerftMoves.size(), 0);
+      PerftNext = 0;
+
+      for (size_t i = 1; i < threadCnt; ++i)
+          Threads[i]->start_searching();
+
+      perft_root(rootPos, Limits.perft * ONE_PLY);
+
+      for (size_t i = 1; i < threadCnt; ++i)
+          Threads[i]->wait_for_search_finished();
+
+      uint64_t cnt = 0;
+      for (size_t i = 0; i < PerftMoves.size(); ++i)
+      {
+          sync_cout << UCI::move(rootPos, PerftMoves[i]) << ": " << PerftCounts[i] << sync_endl;
+          cnt += PerftCounts[i];
+      }
+
+      PerftTable.clear();
+      PerftTable.shrink_to_fit();
+      sync_cout << "\nNodes searched: " << cnt << "\n" << sync_endl;
       return;
   }
 
   Color us = rootPos.side_to_move();
   Time.init(rootPos, Limits, us, rootPos.game_ply());
+  infoInterval = Options["Info Interval"];
+  lastPvTime = lastCurrmoveTime = 0;
+  pvPending = false;
   TT.new_search();
+  Cluster::sync_start();
 
   if (rootMoves.empty())
   {
       rootMoves.emplace_back(MOVE_NONE);
       Value variantResult;
-      sync_cout << "info depth 0 score "
-                << UCI::value(  rootPos.is_game_end(variantResult) ? variantResult
-                              : rootPos.checkers() ? rootPos.checkmate_value() : rootPos.stalemate_value())
-                << sync_endl;
+      if (!Limits.batch)
+          sync_cout << "info depth 0 score "
+                    << UCI::value(  rootPos.is_game_end(variantResult) ? variantResult
+                                  : rootPos.checkers() ? rootPos.checkmate_value() : rootPos.stalemate_value())
+                    << sync_endl;
   }
+  else if (Threads.bookMove)
+      sync_cout << "info string book move " << UCI::move(rootPos, rootMoves[0].pv[0]) << sync_endl;
   else
   {
       for (Thread* th : Threads)
@@ -225,7 +345,7 @@ void MainThread::search() {
   Threads.stopOnPonderhit = true;
 
   while (!Threads.stop && (Threads.ponder || Limits.infinite))
-  {} // Busy wait for a stop or a ponder reset
+      Cluster::signals_poll(); // Busy wait for a stop or a ponder reset
 
   // Stop the threads if not already stopped (also raise the stop if
   // "ponderhit" just reset Threads.ponder).
@@ -236,17 +356,21 @@ void MainThread::search() {
       if (th != this)
           th->wait_for_search_finished();
 
+  // Wait until all ranks of the cluster have finished
+  Cluster::sync_stop();
+
   // When playing in 'nodes as time' mode, subtract the searched nodes from
   // the available ones before exiting.
   if (Limits.npmsec)
       Time.availableNodes += Limits.inc[us] - Threads.nodes_searched();
 
   // Check if there are threads with a better score than main thread
-  Thread* bestThread = this;
-  if (    Options["MultiPV"] == 1
-      && !Limits.depth
-      && !Skill(Options["Skill Level"]).enabled()
-      &&  rootMoves[0].pv[0] != MOVE_NONE)
+  bestThread = this;
+  bool selectBest =    Options["MultiPV"] == 1
+                    && !Limits.depth
+                    && !Skill(Options["Skill Level"]).enabled()
+                    &&  rootMoves[0].pv[0] != MOVE_NONE;
+  if (selectBest)
   {
       for (Thread* th : Threads)
       {
@@ -260,12 +384,53 @@ void MainThread::search() {
       }
   }
 
+  // In a cluster, all ranks play the best move found by any of them
+  bool clusterBest = false;
+  if (Cluster::size() > 1)
+  {
+      RootMove& rm = bestThread->rootMoves[0];
+      if (rm.pv.size() == 1)
+          rm.extract_ponder_from_tt(rootPos);
+
+      Cluster::MoveInfo mi;
+      mi.depth = bestThread->completedDepth;
+      mi.selDepth = rm.selDepth;
+      mi.score = rm.score;
+      mi.pvLength = int(std::min(rm.pv.size(), size_t(MAX_PLY)));
+      std::copy(rm.pv.begin(), rm.pv.begin() + mi.pvLength, mi.pv);
+
+      Cluster::pick_moves(mi, selectBest);
+
+      if (mi.rank != Cluster::rank())
+      {
+          rm.pv.assign(mi.pv, mi.pv + mi.pvLength);
+          rm.score = Value(mi.score);
+          rm.selDepth = mi.selDepth;
+          bestThread->completedDepth = Depth(mi.depth);
+          clusterBest = true;
+      }
+  }
+
   previousScore = bestThread->rootMoves[0].score;
 
-  // Send again PV info if we have a new best thread
-  if (bestThread != this)
+  // In a batch the result is taken from the best thread, see analyze()
+  if (Limits.batch)
+      return;
+
+  // Send again PV info if we have a new best thread, or if the last update
+  // was held back by the info interval.
+  if (bestThread != this || clusterBest || pvPending)
       sync_cout << UCI::pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
 
+  // All the threads are stopped, so their counters can be summed safely
+  if (Options["Search Stats"])
+  {
+      sync_cout << Threads.stats() << sync_endl;
+
+      if (Threads.stopTime)
+          sync_cout << "info string stop latency " << now() - Threads.stopTime << " ms" << sync_endl;
+  }
+
   sync_cout << "bestmove " << UCI::move(rootPos, bestThread->rootMoves[0].pv[0]);
 
   if (bestThread->rootMoves[0].pv.size() > 1 || bestThread->rootMoves[0].extract_ponder_from_tt(rootPos))
@@ -281,6 +446,12 @@ void MainThread::search() {
 
 void Thread::search() {
 
+  if (Limits.perft)
+  {
+      perft_root(rootPos, Limits.perft * ONE_PLY);
+      return;
+  }
+
   Stack stack[MAX_PLY+7], *ss = stack+4; // To reference from (ss-4) to (ss+2)
   Value bestValue, alpha, beta, delta;
   Move  lastBestMove = MOVE_NONE;
@@ -292,7 +463,7 @@ void Thread::search() {
 
   std::memset(ss-4, 0, 7 * sizeof(Stack));
   for (int i = 4; i > 0; i--)
-     (ss-i)->contHistory = this->contHistory[NO_PIECE][0].get(); // Use as sentinel
+     (ss-i)->contHistory = &this->contHistory[NO_PIECE][0]; // Use as sentinel
 
   bestValue = delta = alpha = -VALUE_INFINITE;
   beta = VALUE_INFINITE;
@@ -310,6 +481,12 @@ void Thread::search() {
 
   multiPV = std::min(multiPV, rootMoves.size());
 
+  // Scheme used to diversify the helper threads, see the "SMP Scheme" option
+  const int smpScheme =  Options["SMP Scheme"] == "Alternate" ? SMP_ALTERNATE
+                       : Options["SMP Scheme"] == "None"      ? SMP_NONE
+                                                              : SMP_SKIP_BLOCKS;
+  const bool rootSplit = idx > 0 && Options["SMP Root Split"] && multiPV == 1;
+
   int ct = int(Options["Contempt"]) * PawnValueEg / 100; // From centipawns
 
   // In analysis mode, adjust contempt in accordance with user preference
@@ -333,7 +510,9 @@ void Thread::search() {
       if (idx > 0)
       {
           int i = (idx - 1) % 20;
-          if (((rootDepth / ONE_PLY + rootPos.game_ply() + SkipPhase[i]) / SkipSize[i]) % 2)
+          if (  smpScheme == SMP_SKIP_BLOCKS
+              ? ((rootDepth / ONE_PLY + rootPos.game_ply() + SkipPhase[i]) / SkipSize[i]) % 2
+              : smpScheme == SMP_ALTERNATE && (rootDepth / ONE_PLY + idx) % 2)
               continue;  // Retry with an incremented rootDepth
       }
 
@@ -358,6 +537,16 @@ void Thread::search() {
               for (pvLast++; pvLast < rootMoves.size(); pvLast++)
                   if (rootMoves[pvLast].tbRank != rootMoves[pvFirst].tbRank)
                       break;
+
+              // Let each helper start with a different part of the root moves
+              // after the PV move, so that they fill the TT with different subtrees.
+              if (rootSplit && pvLast - pvFirst > 2)
+              {
+                  size_t n = pvLast - pvFirst - 1;
+                  std::rotate(rootMoves.begin() + pvFirst + 1,
+                              rootMoves.begin() + pvFirst + 1 + idx * n / Threads.size(),
+                              rootMoves.begin() + pvLast);
+              }
           }
 
           // Reset UCI info selDepth for each depth and each PV line
@@ -405,7 +594,7 @@ void Thread::search() {
                   && multiPV == 1
                   && (bestValue <= alpha || bestValue >= beta)
                   && Time.elapsed() > 3000)
-                  sync_cout << UCI::pv(rootPos, rootDepth, alpha, beta) << sync_endl;
+                  mainThread->print_pv(rootDepth, alpha, beta);
 
               // In case of failing low/high increase aspiration window and
               // re-search, otherwise exit the loop.
@@ -435,7 +624,7 @@ void Thread::search() {
 
           if (    mainThread
               && (Threads.stop || pvIdx + 1 == multiPV || Time.elapsed() > 3000))
-              sync_cout << UCI::pv(rootPos, rootDepth, alpha, beta) << sync_endl;
+              mainThread->print_pv(rootDepth, alpha, beta);
       }
 
       if (!Threads.stop)
@@ -479,9 +668,17 @@ void Thread::search() {
               double bestMoveInstability = 1.0 + mainThread->bestMoveChanges;
               bestMoveInstability *= std::pow(mainThread->previousTimeReduction, 0.528) / timeReduction;
 
+              double totalTime = Time.optimum() * bestMoveInstability * improvingFactor / 581;
+
+              // If the best move has not changed for several iterations, the next
+              // iteration would hardly change it before the time runs out.
+              if (   mainThread->bestMoveChanges < 0.05
+                  && lastBestMoveDepth * 2 < completedDepth)
+                  totalTime *= 0.7;
+
               // Stop the search if we have only one legal move, or if available time elapsed
               if (   rootMoves.size() == 1
-                  || Time.elapsed() > Time.optimum() * bestMoveInstability * improvingFactor / 581)
+                  || Time.elapsed() > totalTime)
               {
                   // If we are allowed to ponder do not stop the search now but
                   // keep pondering until the GUI sends "ponderhit" or "stop".
@@ -551,6 +748,7 @@ namespace {
 
     // Step 1. Initialize node
     Thread* thisThread = pos.this_thread();
+    thisThread->stats.searchNodes++;
     inCheck = pos.checkers();
     Color us = pos.side_to_move();
     moveCount = captureCount = quietCount = ss->moveCount = 0;
@@ -592,7 +790,7 @@ namespace {
 
     (ss+1)->ply = ss->ply + 1;
     ss->currentMove = (ss+1)->excludedMove = bestMove = MOVE_NONE;
-    ss->contHistory = thisThread->contHistory[NO_PIECE][0].get();
+    ss->contHistory = &thisThread->contHistory[NO_PIECE][0];
     (ss+2)->killers[0] = (ss+2)->killers[1] = MOVE_NONE;
     Square prevSq = to_sq((ss-1)->currentMove);
 
@@ -609,6 +807,8 @@ namespace {
     excludedMove = ss->excludedMove;
     posKey = pos.key() ^ (Key(excludedMove) << 16); // Isn't a very good hash
     tte = TT.probe(posKey, ttHit);
+    thisThread->stats.ttProbes++;
+    thisThread->stats.ttHits += ttHit;
     ttValue = ttHit ? value_from_tt(tte->value(), ss->ply) : VALUE_NONE;
     ttMove =  rootNode ? thisThread->rootMoves[thisThread->pvIdx].pv[0]
             : ttHit    ? tte->move() : MOVE_NONE;
@@ -673,9 +873,9 @@ namespace {
                 if (    b == BOUND_EXACT
                     || (b == BOUND_LOWER ? value >= beta : value <= alpha))
                 {
-                    tte->save(posKey, value_to_tt(value, ss->ply), b,
-                              std::min(DEPTH_MAX - ONE_PLY, depth + 6 * ONE_PLY),
-                              MOVE_NONE, VALUE_NONE, TT.generation());
+                    Cluster::save(tte, posKey, value_to_tt(value, ss->ply), b,
+                                  std::min(DEPTH_MAX - ONE_PLY, depth + 6 * ONE_PLY),
+                                  MOVE_NONE, VALUE_NONE);
 
                     return value;
                 }
@@ -715,8 +915,8 @@ namespace {
         (ss-1)->currentMove != MOVE_NULL ? evaluate(pos)
                                          : -(ss-1)->staticEval + 2 * Eval::tempo_value(pos);
 
-        tte->save(posKey, VALUE_NONE, BOUND_NONE, DEPTH_NONE, MOVE_NONE,
-                  ss->staticEval, TT.generation());
+        Cluster::save(tte, posKey, VALUE_NONE, BOUND_NONE, DEPTH_NONE, MOVE_NONE,
+                      ss->staticEval);
     }
 
     // Step 7. Razoring (~2 Elo)
@@ -767,7 +967,7 @@ namespace {
         Depth R = ((823 + 67 * depth / ONE_PLY) / 256 + std::min((eval - beta) / PawnValueMg, 3)) * ONE_PLY;
 
         ss->currentMove = MOVE_NULL;
-        ss->contHistory = thisThread->contHistory[NO_PIECE][0].get();
+        ss->contHistory = &thisThread->contHistory[NO_PIECE][0];
 
         pos.do_null_move(st);
 
@@ -819,7 +1019,7 @@ namespace {
                 probCutCount++;
 
                 ss->currentMove = move;
-                ss->contHistory = thisThread->contHistory[pos.moved_piece(move)][to_sq(move)].get();
+                ss->contHistory = &thisThread->contHistory[pos.moved_piece(move)][to_sq(move)];
 
                 assert(depth >= 5 * ONE_PLY);
 
@@ -885,7 +1085,8 @@ moves_loop: // When in check, search starts from here
 
       ss->moveCount = ++moveCount;
 
-      if (rootNode && thisThread == Threads.main() && Time.elapsed() > 3000)
+      if (   rootNode && thisThread == Threads.main() && !Limits.batch && Time.elapsed() > 3000
+          && static_cast<MainThread*>(thisThread)->currmove_due())
           sync_cout << "info depth " << depth / ONE_PLY
                     << " currmove " << UCI::move(pos, move)
                     << " currmovenumber " << moveCount + thisThread->pvIdx << sync_endl;
@@ -984,8 +1185,10 @@ moves_loop: // When in check, search starts from here
       prefetch(TT.first_entry(pos.key_after(move)));
 
       // Check for legality just before making the move
+      thisThread->stats.legalChecks += !rootNode;
       if (!rootNode && !pos.legal(move))
       {
+          thisThread->stats.illegalMoves++;
           ss->moveCount = --moveCount;
           continue;
       }
@@ -995,7 +1198,7 @@ moves_loop: // When in check, search starts from here
 
       // Update the current move (this must be done after singular extension search)
       ss->currentMove = move;
-      ss->contHistory = thisThread->contHistory[movedPiece][to_sq(move)].get();
+      ss->contHistory = &thisThread->contHistory[movedPiece][to_sq(move)];
 
       // Step 15. Make the move
       pos.do_move(move, st, givesCheck);
@@ -1140,6 +1343,8 @@ moves_loop: // When in check, search starts from here
               else
               {
                   assert(value >= beta); // Fail high
+                  thisThread->stats.cutoffs++;
+                  thisThread->stats.firstMoveCutoffs += (moveCount == 1);
                   ss->statScore = 0;
                   break;
               }
@@ -1197,10 +1402,10 @@ moves_loop: // When in check, search starts from here
         bestValue = std::min(bestValue, maxValue);
 
     if (!excludedMove)
-        tte->save(posKey, value_to_tt(bestValue, ss->ply),
-                  bestValue >= beta ? BOUND_LOWER :
-                  PvNode && bestMove ? BOUND_EXACT : BOUND_UPPER,
-                  depth, bestMove, ss->staticEval, TT.generation());
+        Cluster::save(tte, posKey, value_to_tt(bestValue, ss->ply),
+                      bestValue >= beta ? BOUND_LOWER :
+                      PvNode && bestMove ? BOUND_EXACT : BOUND_UPPER,
+                      depth, bestMove, ss->staticEval);
 
     assert(bestValue > -VALUE_INFINITE && bestValue < VALUE_INFINITE);
 
@@ -1229,6 +1434,9 @@ moves_loop: // When in check, search starts from here
     Value bestValue, value, ttValue, futilityValue, futilityBase, oldAlpha;
     bool ttHit, inCheck, givesCheck, evasionPrunable;
     int moveCount;
+    SearchStats& stats = pos.this_thread()->stats;
+
+    stats.qsearchNodes++;
 
     if (PvNode)
     {
@@ -1262,6 +1470,8 @@ moves_loop: // When in check, search starts from here
     tte = TT.probe(posKey, ttHit);
     ttValue = ttHit ? value_from_tt(tte->value(), ss->ply) : VALUE_NONE;
     ttMove = ttHit ? tte->move() : MOVE_NONE;
+    stats.ttProbes++;
+    stats.ttHits += ttHit;
 
     if (  !PvNode
         && ttHit
@@ -1372,8 +1582,10 @@ moves_loop: // When in check, search starts from here
       prefetch(TT.first_entry(pos.key_after(move)));
 
       // Check for legality just before making the move
+      stats.legalChecks++;
       if (!pos.legal(move))
       {
+          stats.illegalMoves++;
           moveCount--;
           continue;
       }
@@ -1404,6 +1616,8 @@ moves_loop: // When in check, search starts from here
               }
               else // Fail high
               {
+                  stats.cutoffs++;
+                  stats.firstMoveCutoffs += (moveCount == 1);
                   tte->save(posKey, value_to_tt(value, ss->ply), BOUND_LOWER,
                             ttDepth, move, ss->staticEval, TT.generation());
 
@@ -1581,17 +1795,60 @@ void MainThread::check_time() {
       dbg_print();
   }
 
+  // Exchange signals and TT entries with the other ranks of the cluster
+  Cluster::signals_poll();
+
   // We should not stop pondering until told so by the GUI
   if (Threads.ponder)
       return;
 
   if (   (Limits.use_time_management() && elapsed > Time.maximum() - 10)
       || (Limits.movetime && elapsed >= Limits.movetime)
-      || (Limits.nodes && Threads.nodes_searched() >= (uint64_t)Limits.nodes))
+      || (Limits.nodes && Cluster::nodes_searched() >= (uint64_t)Limits.nodes))
       Threads.stop = true;
 }
 
 
+/// MainThread::print_pv() sends the PV information to the GUI, but not more
+/// often than allowed by the "Info Interval" option, because with many PV lines
+/// formatting and writing them can take a noticeable part of the search time.
+/// A held back update is sent at the end of the search.
+
+void MainThread::print_pv(Depth depth, Value alpha, Value beta) {
+
+  if (Limits.batch)
+      return;
+
+  TimePoint tick = now();
+
+  if (infoInterval && tick - lastPvTime < infoInterval)
+  {
+      pvPending = true;
+      return;
+  }
+
+  lastPvTime = tick;
+  pvPending = false;
+  sync_cout << UCI::pv(rootPos, depth, alpha, beta) << sync_endl;
+}
+
+
+/// MainThread::currmove_due() rate limits the currmove information in the same way
+
+bool MainThread::currmove_due() {
+
+  if (!infoInterval)
+      return true;
+
+  TimePoint tick = now();
+  if (tick - lastCurrmoveTime < infoInterval)
+      return false;
+
+  lastCurrmoveTime = tick;
+  return true;
+}
+
+
 /// UCI::pv() formats PV information according to the UCI protocol. UCI requires
 /// that all (if any) unsearched PV lines are sent using a previous search score.
 
@@ -1602,8 +1859,8 @@ string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
   const RootMoves& rootMoves = pos.this_thread()->rootMoves;
   size_t pvIdx = pos.this_thread()->pvIdx;
   size_t multiPV = std::min((size_t)Options["MultiPV"], rootMoves.size());
-  uint64_t nodesSearched = Threads.nodes_searched();
-  uint64_t tbHits = Threads.tb_hits() + (TB::RootInTB ? rootMoves.size() : 0);
+  uint64_t nodesSearched = Cluster::nodes_searched();
+  uint64_t tbHits = Cluster::tb_hits() + (TB::RootInTB ? rootMoves.size() : 0);
 
   for (size_t i = 0; i < multiPV; ++i)
   {
@@ -1685,6 +1942,9 @@ void Tablebases::rank_root_moves(Position& pos, Search::RootMoves& rootMoves) {
     Cardinality = int(Options["SyzygyProbeLimit"]);
     bool dtz_available = true;
 
+    if (Options["SyzygyPrefetch"])
+        prefetch(pos);
+
     // Tables with fewer pieces than SyzygyProbeLimit are searched with
     // ProbeDepth == DEPTH_ZERO
     if (Cardinality > MaxCardinality)
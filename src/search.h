@@ -27,6 +27,8 @@
 #include "movepick.h"
 #include "types.h"
 
+struct SearchParams;
+
 class Position;
 
 namespace Search {
@@ -83,8 +85,8 @@ typedef std::vector<RootMove> RootMoves;
 struct LimitsType {
 
   LimitsType() { // Init explicitly due to broken value-initialization of non POD in MSVC
-    time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = TimePoint(0);
-    movestogo = depth = mate = perft = infinite = 0;
+    time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = byoyomi = npmsec = movetime = TimePoint(0);
+    movestogo = depth = mate = perft = perftThreads = perftHash = infinite = batch = 0;
     nodes = 0;
   }
 
@@ -93,14 +95,16 @@ struct LimitsType {
   }
 
   std::vector<Move> searchmoves;
-  TimePoint time[COLOR_NB], inc[COLOR_NB], npmsec, movetime, startTime;
-  int movestogo, depth, mate, perft, infinite;
+  TimePoint time[COLOR_NB], inc[COLOR_NB], byoyomi, npmsec, movetime, startTime;
+  int movestogo, depth, mate, perft, perftThreads, perftHash, infinite;
+  int batch; // Search without output, the result is read by analyze()
   int64_t nodes;
 };
 
 extern LimitsType Limits;
 
 void init();
+void init(const SearchParams& params);
 void clear();
 
 } // namespace Search
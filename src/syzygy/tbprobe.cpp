@@ -19,19 +19,25 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstring>   // For std::memset and std::memcpy
 #include <deque>
 #include <fstream>
 #include <iostream>
 #include <list>
+#include <map>
+#include <memory>
 #include <sstream>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 
 #include "../bitboard.h"
 #include "../movegen.h"
 #include "../position.h"
 #include "../search.h"
+#include "../thread.h"
 #include "../thread_win32.h"
 #include "../types.h"
 #include "../uci.h"
@@ -39,6 +45,7 @@
 #include "tbprobe.h"
 
 #ifndef _WIN32
+#include <dirent.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
@@ -58,7 +65,7 @@ namespace {
 constexpr int TBPIECES = 6; // Max number of supported pieces
 
 enum { BigEndian, LittleEndian };
-enum TBType { KEY, WDL, DTZ }; // Used as template parameter
+enum TBType { KEY, WDL, DTZ, VTB }; // Used as template parameter
 
 // Each table has a set of flags: all of them refer to DTZ tables, the last one to WDL tables
 enum TBFlag { STM = 1, Mapped = 2, WinPlies = 4, LossPlies = 8, SingleValue = 128 };
@@ -253,9 +260,10 @@ public:
         uint8_t* data = (uint8_t*)*baseAddress;
 
         constexpr uint8_t Magics[][4] = { { 0xD7, 0x66, 0x0C, 0xA5 },
-                                          { 0x71, 0xE8, 0x23, 0x5D } };
+                                          { 0x71, 0xE8, 0x23, 0x5D },
+                                          { 0x5A, 0x3C, 0x91, 0xE7 } };
 
-        if (memcmp(data, Magics[type == WDL], 4)) {
+        if (memcmp(data, Magics[type == VTB ? 2 : type == WDL], 4)) {
             std::cerr << "Corrupted table in file " << fname << std::endl;
             unmap(*baseAddress, *mapping);
             return *baseAddress = nullptr, nullptr;
@@ -264,6 +272,17 @@ public:
         return data + 4; // Skip Magics's header
     }
 
+    // Ask the OS to read the mapped file in the background, so that the first
+    // probes do not stall on page faults.
+    static void prefetch(void* baseAddress, uint64_t mapping) {
+
+#ifndef _WIN32
+        madvise(baseAddress, mapping, MADV_WILLNEED);
+#else
+        (void)baseAddress, (void)mapping; // PrefetchVirtualMemory() needs Windows 8
+#endif
+    }
+
     static void unmap(void* baseAddress, uint64_t mapping) {
 
 #ifndef _WIN32
@@ -318,6 +337,7 @@ struct TBTable {
     uint64_t mapping;
     Key key;
     Key key2;
+    std::string code; // Like "KRvK", the file name without extension
     int pieceCount;
     bool hasPawns;
     bool hasUniquePieces;
@@ -329,7 +349,7 @@ struct TBTable {
     }
 
     TBTable() : ready(false), baseAddress(nullptr) {}
-    explicit TBTable(const std::string& code);
+    explicit TBTable(const std::string& str);
     explicit TBTable(const TBTable<WDL>& wdl);
 
     ~TBTable() {
@@ -339,11 +359,12 @@ struct TBTable {
 };
 
 template<>
-TBTable<WDL>::TBTable(const std::string& code) : TBTable() {
+TBTable<WDL>::TBTable(const std::string& str) : TBTable() {
 
     StateInfo st;
     Position pos;
 
+    code = str;
     key = pos.set(code, WHITE, &st).material_key();
     pieceCount = pos.count<ALL_PIECES>();
     hasPawns = pos.pieces(PAWN);
@@ -372,6 +393,7 @@ TBTable<DTZ>::TBTable(const TBTable<WDL>& wdl) : TBTable() {
     // Use the corresponding WDL table to avoid recalculating all from scratch
     key = wdl.key;
     key2 = wdl.key2;
+    code = wdl.code;
     pieceCount = wdl.pieceCount;
     hasPawns = wdl.hasPawns;
     hasUniquePieces = wdl.hasUniquePieces;
@@ -421,6 +443,7 @@ public:
         dtzTable.clear();
     }
     size_t size() const { return wdlTable.size(); }
+    std::deque<TBTable<WDL>>& wdl_tables() { return wdlTable; }
     void add(const std::vector<PieceType>& pieces);
 };
 
@@ -1071,12 +1094,12 @@ void set(T& e, uint8_t* data) {
         }
 }
 
-// If the TB file corresponding to the given position is already memory mapped
-// then return its base address, otherwise try to memory map and init it. Called
-// at every probe, memory map and init only at first access. Function is thread
-// safe and can be called concurrently.
+// If the TB file of the given table is already memory mapped then return its
+// base address, otherwise try to memory map and init it. Called at every probe,
+// memory map and init only at first access. Function is thread safe and can be
+// called concurrently.
 template<TBType Type>
-void* mapped(TBTable<Type>& e, const Position& pos) {
+void* mapped(TBTable<Type>& e) {
 
     static Mutex mutex;
 
@@ -1090,17 +1113,7 @@ void* mapped(TBTable<Type>& e, const Position& pos) {
     if (e.ready.load(std::memory_order_relaxed)) // Recheck under lock
         return e.baseAddress;
 
-    // Pieces strings in decreasing order for each color, like ("KPP","KR")
-    std::string fname, w, b;
-    for (PieceType pt = KING; pt >= PAWN; --pt) {
-        w += std::string(popcount(pos.pieces(WHITE, pt)), PieceToChar[pt]);
-        b += std::string(popcount(pos.pieces(BLACK, pt)), PieceToChar[pt]);
-    }
-
-    fname =  (e.key == pos.material_key() ? w + 'v' + b : b + 'v' + w)
-           + (Type == WDL ? ".rtbw" : ".rtbz");
-
-    uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type);
+    uint8_t* data = TBFile(e.code + (Type == WDL ? ".rtbw" : ".rtbz")).map(&e.baseAddress, &e.mapping, Type);
 
     if (data)
         set(e, data);
@@ -1117,7 +1130,7 @@ Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw)
 
     TBTable<Type>* entry = TBTables.get<Type>(pos.material_key());
 
-    if (!entry || !mapped(*entry, pos))
+    if (!entry || !mapped(*entry))
         return *result = FAIL, Ret();
 
     return do_probe_table(pos, entry, wdl, result);
@@ -1145,7 +1158,7 @@ WDLScore search(Position& pos, ProbeState* result) {
     auto moveList = MoveList<LEGAL>(pos);
     size_t totalCount = moveList.size(), moveCount = 0;
 
-    for (const Move& move : moveList)
+    for (const auto& move : moveList)
     {
         if (   !pos.capture(move)
             && (!CheckZeroingMoves || type_of(pos.moved_piece(move)) != PAWN))
@@ -1198,6 +1211,390 @@ WDLScore search(Position& pos, ProbeState* result) {
     return *result = OK, value;
 }
 
+// Variant tablebases
+//
+// The Syzygy tables only know the rules of chess. For other variants without
+// drops or check counting, tables are generated by Tablebases::generate() with a
+// plain retrograde analysis that uses the rules as implemented by Position, so
+// that stalemateValue, bareKingValue, extinction and flag rules are respected.
+// A file like "makruk_KMvK.vtb" covers one material configuration with both
+// sides to move. After the magic, the header stores the number of pieces, the
+// board size and the piece characters in indexing order. Then for each index,
+// see vtb_index(), a 16 bit value follows: 0 for a draw or an illegal position,
+// and +/-(dtz + 1) for a win/loss, where dtz is the distance in plies to the end
+// of the game or to the next zeroing move (capture or pawn move).
+
+constexpr int VTBPieces = 8;                    // Max number of pieces in a table
+constexpr int VTBHeaderSize = 4 + 4 + VTBPieces; // Magic, sizes and pieces
+constexpr uint64_t VTBMaxSize = 1 << 22;         // Max number of entries of a table
+
+// Variants with pieces in hand or a state not given by the board cannot be indexed
+bool vtb_supported(const Variant* v) {
+
+    return   !v->pieceDrops && !v->capturesToHand && !v->pieceDemotion
+          && !v->maxCheckCount && !v->shatarMateRule
+          && std::all_of(std::begin(v->promotedPieceType), std::end(v->promotedPieceType),
+                         [](PieceType pt) { return pt == NO_PIECE_TYPE; });
+}
+
+// Pieces are ordered by color, with the king first and then by piece type
+bool vtb_less(Piece p1, Piece p2) {
+
+    return   color_of(p1) != color_of(p2) ? color_of(p1) < color_of(p2)
+           : (type_of(p1) != KING) < (type_of(p2) != KING) ? true
+           : (type_of(p1) != KING) > (type_of(p2) != KING) ? false
+           : type_of(p1) < type_of(p2);
+}
+
+// Encode the squares of the pieces, the first piece varying fastest, and the side
+// to move. Pieces of the same kind are assigned to their squares in bitboard order.
+uint64_t vtb_index(const Position& pos, const Piece* pieces, int n) {
+
+    int files = pos.max_file() + 1, nsq = files * (pos.max_rank() + 1);
+    Square sq[VTBPieces];
+    Bitboard b = 0;
+
+    for (int i = 0; i < n; ++i)
+    {
+        if (!i || pieces[i] != pieces[i - 1])
+            b = pos.pieces(color_of(pieces[i]), type_of(pieces[i]));
+        sq[i] = pop_lsb(&b);
+    }
+
+    uint64_t idx = 0;
+    for (int i = n - 1; i >= 0; --i)
+        idx = idx * nsq + rank_of(sq[i]) * files + file_of(sq[i]);
+
+    return 2 * idx + pos.side_to_move();
+}
+
+// FEN of a position with the given pieces on the given squares, or on the first
+// squares of the board if none are given
+std::string vtb_fen(const Variant* v, const std::vector<Piece>& pieces, const Square* sq, Color stm) {
+
+    int files = v->maxFile + 1;
+    char board[RANK_NB][FILE_NB] = {};
+
+    for (size_t i = 0; i < pieces.size(); ++i)
+    {
+        Square s = sq ? sq[i] : make_square(File(i % files), Rank(i / files));
+        board[rank_of(s)][file_of(s)] = v->pieceToChar[pieces[i]];
+    }
+
+    std::string fen;
+    for (Rank r = v->maxRank; r >= RANK_1; --r)
+    {
+        int emptyCnt = 0;
+        for (File f = FILE_A; f <= v->maxFile; ++f)
+        {
+            if (!board[r][f])
+                ++emptyCnt;
+            else
+            {
+                if (emptyCnt)
+                    fen += std::to_string(emptyCnt);
+                fen += board[r][f];
+                emptyCnt = 0;
+            }
+        }
+        if (emptyCnt)
+            fen += std::to_string(emptyCnt);
+        if (r > RANK_1)
+            fen += '/';
+    }
+
+    return fen + (stm == WHITE ? " w - - 0 1" : " b - - 0 1");
+}
+
+// Table value of a position that is over, from the point of view of the side to move
+int vtb_terminal(Value result) {
+    return result > VALUE_DRAW ? 1 : result < VALUE_DRAW ? -1 : 0;
+}
+
+// Table value of a move given the value of the position after it
+int vtb_parent(int v, bool zeroing) {
+    return  v < 0 ?  (zeroing ? 2 : 1 - v)
+          : v > 0 ? -(zeroing ? 2 : v + 1) : 0;
+}
+
+// struct VariantTable is the counterpart of TBTable for a variant table. It is
+// created when the file is found at init time and mapped at first access.
+struct VariantTable {
+    std::atomic_bool ready;
+    void* baseAddress;
+    uint64_t mapping;
+    const int16_t* data;
+    const Variant* variant;
+    std::string fname;
+    Key key;
+    int pieceCount;
+    Piece pieces[VTBPieces];
+
+    VariantTable(const Variant* v, const std::string& f, Key k, int cnt)
+        : ready(false), baseAddress(nullptr), data(nullptr), variant(v), fname(f), key(k), pieceCount(cnt) {}
+
+    ~VariantTable() {
+        if (baseAddress)
+            TBFile::unmap(baseAddress, mapping);
+    }
+};
+
+std::deque<VariantTable> VariantTables;
+std::unordered_map<Key, VariantTable*> VariantTableIndex; // Keyed by vtb_key()
+
+Key vtb_key(const Variant* v, Key materialKey) {
+    return materialKey ^ (Key(uintptr_t(v)) * 0x9E3779B97F4A7C15ULL);
+}
+
+// Like mapped() for Syzygy tables, thread safe
+const int16_t* mapped(VariantTable& e) {
+
+    static Mutex mutex;
+
+    if (e.ready.load(std::memory_order_acquire))
+        return e.data; // Could be nullptr if file is missing or corrupted
+
+    std::unique_lock<Mutex> lk(mutex);
+
+    if (e.ready.load(std::memory_order_relaxed))
+        return e.data;
+
+    TBFile file(e.fname);
+    uint8_t* data = file.is_open() ? file.map(&e.baseAddress, &e.mapping, VTB) : nullptr;
+
+    if (data)
+    {
+        const Variant* v = e.variant;
+        bool ok =   data[0] == e.pieceCount
+                 && data[1] == v->maxFile + 1
+                 && data[2] == v->maxRank + 1;
+
+        for (int i = 0; ok && i < e.pieceCount; ++i)
+        {
+            size_t idx = v->pieceToChar.find(char(data[4 + i]));
+            ok = idx != std::string::npos && idx != 0;
+            e.pieces[i] = Piece(idx);
+        }
+
+        if (ok)
+            e.data = (const int16_t*)(data + VTBHeaderSize - 4);
+        else
+        {
+            std::cerr << "Corrupted table in file " << e.fname << std::endl;
+            TBFile::unmap(e.baseAddress, e.mapping);
+            e.baseAddress = nullptr;
+        }
+    }
+
+    e.ready.store(true, std::memory_order_release);
+    return e.data;
+}
+
+// Probe the variant table of the position. Positions with an en passant square
+// are not stored, their value is found with a 1-ply search.
+int probe_variant(Position& pos, ProbeState* result) {
+
+    if (pos.ep_square() != SQ_NONE)
+    {
+        Value gameResult;
+        if (pos.is_immediate_game_end(gameResult))
+            return vtb_terminal(gameResult);
+
+        StateInfo st;
+        int best = 0, bestScore = -0x20000;
+        bool anyMove = false;
+
+        for (const auto& move : MoveList<LEGAL>(pos))
+        {
+            anyMove = true;
+            pos.do_move(move, st);
+            bool zeroing = pos.rule50_count() == 0;
+            int v = pos.is_immediate_game_end(gameResult) ? vtb_terminal(gameResult)
+                                                          : probe_variant(pos, result);
+            pos.undo_move(move);
+
+            if (*result == FAIL)
+                return 0;
+
+            // Prefer the shortest win and the longest loss
+            v = vtb_parent(v, zeroing);
+            int score = v > 0 ? 0x10000 - v : v < 0 ? -0x10000 - v : 0;
+            if (score > bestScore)
+                best = v, bestScore = score;
+        }
+
+        return anyMove ? best : vtb_terminal(pos.checkers() ? pos.checkmate_value() : pos.stalemate_value());
+    }
+
+    auto it = VariantTableIndex.find(vtb_key(pos.variant(), pos.material_key()));
+
+    if (   it == VariantTableIndex.end()
+        || it->second->variant != pos.variant()
+        || pos.can_castle(ANY_CASTLING))
+        return *result = FAIL, 0;
+
+    VariantTable& e = *it->second;
+    const int16_t* data = mapped(e);
+
+    if (!data)
+        return *result = FAIL, 0;
+
+    return data[vtb_index(pos, e.pieces, e.pieceCount)];
+}
+
+// Returns true if the position belongs to a variant table, in that case
+// probe_wdl() and probe_dtz() use it instead of the Syzygy tables.
+bool has_variant_table(const Position& pos) {
+
+    return   !VariantTableIndex.empty()
+          &&  VariantTableIndex.count(vtb_key(pos.variant(), pos.material_key()));
+}
+
+// Add the variant tables found in the given directories
+void add_variant_tables(const std::string& paths) {
+
+#ifndef _WIN32
+    constexpr char SepChar = ':';
+#else
+    constexpr char SepChar = ';';
+#endif
+    std::stringstream ss(paths);
+    std::string path;
+
+    while (std::getline(ss, path, SepChar))
+    {
+        std::vector<std::string> fnames;
+
+#ifndef _WIN32
+        if (DIR* dir = opendir(path.c_str()))
+        {
+            while (dirent* entry = readdir(dir))
+                fnames.push_back(entry->d_name);
+            closedir(dir);
+        }
+#else
+        WIN32_FIND_DATA data;
+        HANDLE h = FindFirstFile((path + "\\*.vtb").c_str(), &data);
+        if (h != INVALID_HANDLE_VALUE)
+        {
+            do fnames.push_back(data.cFileName); while (FindNextFile(h, &data));
+            FindClose(h);
+        }
+#endif
+
+        // File names are like "makruk_KMvK.vtb"
+        for (const std::string& fname : fnames)
+        {
+            size_t sep = fname.rfind('_');
+
+            if (   fname.size() < 4
+                || fname.compare(fname.size() - 4, 4, ".vtb")
+                || sep == std::string::npos)
+                continue;
+
+            auto v = variants.find(fname.substr(0, sep));
+            std::string code = fname.substr(sep + 1, fname.size() - sep - 5);
+
+            if (v == variants.end() || !vtb_supported(v->second))
+                continue;
+
+            // Set up a dummy position with the material of the table to get its key
+            std::vector<Piece> pieces;
+            Color c = WHITE;
+            for (char ch : code)
+            {
+                size_t idx = v->second->pieceToChar.find(toupper(ch));
+                if (ch == 'v')
+                    c = BLACK;
+                else if (idx != std::string::npos && idx && idx < PIECE_TYPE_NB)
+                    pieces.push_back(make_piece(c, type_of(Piece(idx))));
+            }
+
+            if (pieces.empty() || pieces.size() > VTBPieces)
+                continue;
+
+            StateInfo st;
+            Position pos;
+            Key key = pos.set(v->second, vtb_fen(v->second, pieces, nullptr, WHITE), false, &st, nullptr).material_key();
+
+            if (VariantTableIndex.count(vtb_key(v->second, key)))
+                continue; // Already found in a previous directory
+
+            VariantTables.emplace_back(v->second, fname, key, int(pieces.size()));
+            std::sort(pieces.begin(), pieces.end(), vtb_less);
+            std::copy(pieces.begin(), pieces.end(), VariantTables.back().pieces);
+            VariantTableIndex[vtb_key(v->second, key)] = &VariantTables.back();
+            MaxCardinality = std::max(int(pieces.size()), MaxCardinality);
+        }
+    }
+}
+
+
+// WDLCache is a small lock-free cache in front of probe_wdl(), indexed by the lsb
+// of the position key. An entry holds the other bits of the key, and the WDL score
+// plus 3 in its 3 lsb, so that an empty entry never matches.
+constexpr size_t WDLCacheSize = 1 << 16;
+std::atomic<uint64_t> WDLCache[WDLCacheSize];
+
+// Probes that take longer than this (in ns) have waited for the disk
+constexpr int64_t StallTime = 100000;
+
+// Tables are prefetched when the root has at most this many pieces more
+constexpr int PrefetchPieces = 2;
+
+// Prefetcher maps the tables that can be reached from the root position on a
+// background thread, so that the search does not wait for it.
+struct Prefetcher {
+    std::thread th;
+    std::atomic_bool busy;
+
+    Prefetcher() : busy(false) {}
+    ~Prefetcher() { join(); }
+
+    void join() {
+        if (th.joinable())
+            th.join();
+    }
+} Prefetcher;
+
+// True if the material of a Syzygy table can be reached from the position, with
+// the strong side being either color.
+bool reachable(const std::string& code, const Position& pos) {
+
+    std::string w = code.substr(0, code.find('v')), b = code.substr(code.find('v') + 1);
+
+    auto fits = [&](const std::string& s, Color c) {
+        return std::all_of(s.begin(), s.end(), [&](char ch) {
+            return std::count(s.begin(), s.end(), ch) <= pos.count(c, PieceType(PieceToChar.find(ch)));
+        });
+    };
+
+    return (fits(w, WHITE) && fits(b, BLACK)) || (fits(w, BLACK) && fits(b, WHITE));
+}
+
+bool reachable(const VariantTable& e, const Position& pos) {
+
+    return   e.variant == pos.variant()
+          && std::all_of(e.pieces, e.pieces + e.pieceCount, [&](Piece pc) {
+                 return std::count(e.pieces, e.pieces + e.pieceCount, pc) <= pos.count(color_of(pc), type_of(pc));
+             });
+}
+
+WDLScore probe_wdl_table(Position& pos, ProbeState* result) {
+
+    if (has_variant_table(pos))
+    {
+        int v = probe_variant(pos, result);
+        int n = 2 * pos.n_move_rule();
+
+        // Wins and losses that take longer than the n-move rule allows are cursed
+        return  v > 0 ? (n && v - 1 > n ? WDLCursedWin   : WDLWin)
+              : v < 0 ? (n && 1 - v > n ? WDLBlessedLoss : WDLLoss) : WDLDraw;
+    }
+
+    return search<false>(pos, result);
+}
+
 } // namespace
 
 
@@ -1206,7 +1603,13 @@ WDLScore search(Position& pos, ProbeState* result) {
 /// safe, nor it needs to be.
 void Tablebases::init(const std::string& paths) {
 
+    Prefetcher.join();
+    for (auto& e : WDLCache)
+        e.store(0, std::memory_order_relaxed);
+
     TBTables.clear();
+    VariantTableIndex.clear();
+    VariantTables.clear();
     MaxCardinality = 0;
     TBFile::Paths = paths;
 
@@ -1335,6 +1738,51 @@ void Tablebases::init(const std::string& paths) {
     }
 
     sync_cout << "info string Found " << TBTables.size() << " tablebases" << sync_endl;
+
+    add_variant_tables(paths);
+
+    if (VariantTables.size())
+        sync_cout << "info string Found " << VariantTables.size() << " variant tablebases" << sync_endl;
+}
+
+/// Tablebases::prefetch() is called at the start of a search. If the root
+/// position is close to the tables, the tables that can be reached from it are
+/// mapped on a background thread and read ahead by the OS.
+
+void Tablebases::prefetch(const Position& pos) {
+
+    if (   Prefetcher.busy.load(std::memory_order_acquire) // Still working
+        || pos.count<ALL_PIECES>() > MaxCardinality + PrefetchPieces)
+        return;
+
+    std::vector<TBTable<WDL>*> tables;
+    std::vector<VariantTable*> variantTables;
+
+    for (auto& e : TBTables.wdl_tables())
+        if (reachable(e.code, pos))
+            tables.push_back(&e);
+
+    for (auto& e : VariantTables)
+        if (reachable(e, pos))
+            variantTables.push_back(&e);
+
+    if (tables.empty() && variantTables.empty())
+        return;
+
+    Prefetcher.join();
+    Prefetcher.busy = true;
+    Prefetcher.th = std::thread([tables, variantTables]() {
+
+        for (TBTable<WDL>* e : tables)
+            if (mapped(*e))
+                TBFile::prefetch(e->baseAddress, e->mapping);
+
+        for (VariantTable* e : variantTables)
+            if (mapped(*e))
+                TBFile::prefetch(e->baseAddress, e->mapping);
+
+        Prefetcher.busy.store(false, std::memory_order_release);
+    });
 }
 
 // Probe the WDL table for a particular position.
@@ -1347,8 +1795,33 @@ void Tablebases::init(const std::string& paths) {
 //  2 : win
 WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
 
+    SearchStats& stats = pos.this_thread()->stats;
+    Key key = pos.key() ^ vtb_key(pos.variant(), 0);
+    std::atomic<uint64_t>& entry = WDLCache[key & (WDLCacheSize - 1)];
+    uint64_t e = entry.load(std::memory_order_relaxed);
+
     *result = OK;
-    return search<false>(pos, result);
+    stats.tbProbes++;
+
+    if (e && !((e ^ key) & ~uint64_t(7)))
+    {
+        stats.tbCacheHits++;
+        return WDLScore(int(e & 7) - 3);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    WDLScore wdl = probe_wdl_table(pos, result);
+    int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start).count();
+
+    stats.tbProbeTime += elapsed;
+    stats.tbMaxProbeTime = std::max(stats.tbMaxProbeTime, uint64_t(elapsed));
+    stats.tbStalls += elapsed > StallTime;
+
+    if (*result != FAIL)
+        entry.store((key & ~uint64_t(7)) | uint64_t(wdl + 3), std::memory_order_relaxed);
+
+    return wdl;
 }
 
 // Probe the DTZ table for a particular position.
@@ -1380,6 +1853,13 @@ WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
 int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
 
     *result = OK;
+
+    // Variant tables store the DTZ of both sides to move
+    if (has_variant_table(pos))
+    {
+        int v = probe_variant(pos, result);
+        return v > 0 ? v - 1 : v < 0 ? std::min(v + 1, -1) : 0;
+    }
     WDLScore wdl = search<true>(pos, result);
 
     if (*result == FAIL || wdl == WDLDraw) // DTZ tables don't store draws
@@ -1403,7 +1883,7 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
     StateInfo st;
     int minDTZ = 0xFFFF;
 
-    for (const Move& move : MoveList<LEGAL>(pos))
+    for (const auto& move : MoveList<LEGAL>(pos))
     {
         bool zeroing = pos.capture(move) || type_of(pos.moved_piece(move)) == PAWN;
 
@@ -1543,3 +2023,356 @@ bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves) {
 
     return true;
 }
+
+namespace {
+
+// VariantTBGenerator solves the variant tables by retrograde analysis. The tables
+// reached by captures and promotions are solved first and are kept in memory until
+// the generation is done, and all of them are written to the given directory.
+class VariantTBGenerator {
+
+    struct Table {
+        std::string code;
+        std::vector<Piece> pieces;
+        std::vector<int16_t> values;
+    };
+
+    // A successor is the index of a node, possibly with the ZeroBit if the move
+    // is a zeroing one, or a fixed value for a position in another table or a
+    // position where the game is over.
+    static constexpr int32_t ZeroBit = 1 << 30;
+    enum : int32_t { FixedLoss = -1, FixedDraw = -2, FixedWin = -3 };
+    enum : uint8_t { Invalid = 1, Terminal = 2 };
+
+    // Nodes of the table being solved. Positions with an en passant square are
+    // added after the table entries.
+    struct Nodes {
+        Key key;
+        std::vector<int32_t> succ;
+        std::vector<uint32_t> begin, end;
+        std::vector<int8_t> wdl;
+        std::vector<uint8_t> flags;
+        std::vector<int16_t> dtz;
+    };
+
+    const Variant* v;
+    std::string variantName, dir;
+    Thread* th;
+    std::map<Key, std::unique_ptr<Table>> tables;
+    bool failed = false;
+
+    static int32_t fixed(int value) {
+        return value > 0 ? FixedWin : value < 0 ? FixedLoss : FixedDraw;
+    }
+
+    int wdl_of(const Nodes& n, int32_t s) const {
+        return s < 0 ? -s - 2 : n.wdl[s & ~ZeroBit];
+    }
+
+    int dist_of(const Nodes& n, int32_t s) const {
+        return s < 0 || (s & ZeroBit) ? 0 : n.dtz[s];
+    }
+
+    std::string code_of(const std::vector<Piece>& pieces) const {
+        std::string code;
+        for (size_t i = 0; i < pieces.size(); ++i)
+        {
+            if (color_of(pieces[i]) == BLACK && (!i || color_of(pieces[i - 1]) == WHITE))
+                code += 'v';
+            code += char(toupper(v->pieceToChar[pieces[i]]));
+        }
+        return code.find('v') == std::string::npos ? code + 'v' : code;
+    }
+
+    std::vector<Piece> pieces_of(const Position& pos) const {
+        std::vector<Piece> pieces;
+        for (Color c : { WHITE, BLACK })
+            for (PieceType pt : v->pieceTypes)
+                for (int i = 0; i < pos.count(c, pt); ++i)
+                    pieces.push_back(make_piece(c, pt));
+        std::sort(pieces.begin(), pieces.end(), vtb_less);
+        return pieces;
+    }
+
+    void expand(Position& pos, uint32_t id, Nodes& n);
+    void solve(Nodes& n);
+    bool write(const Table& t) const;
+
+public:
+    VariantTBGenerator(const Variant* var, const std::string& name, const std::string& d, Thread* t)
+        : v(var), variantName(name), dir(d), th(t) {}
+
+    const Table* generate(const std::vector<Piece>& pieces);
+};
+
+// Set up the successors of a node, or its value if the game is over
+void VariantTBGenerator::expand(Position& pos, uint32_t id, Nodes& n) {
+
+    Value result;
+    if (pos.is_immediate_game_end(result))
+    {
+        n.flags[id] = Terminal, n.wdl[id] = int8_t(vtb_terminal(result));
+        return;
+    }
+
+    std::vector<int32_t> succ;
+    StateInfo st;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        pos.do_move(m, st);
+        int32_t zeroing = pos.rule50_count() == 0 ? ZeroBit : 0;
+
+        if (pos.is_immediate_game_end(result))
+            succ.push_back(fixed(vtb_terminal(result)));
+
+        else if (pos.ep_square() != SQ_NONE)
+        {
+            uint32_t aux = uint32_t(n.wdl.size());
+            n.begin.push_back(0), n.end.push_back(0), n.wdl.push_back(0);
+            n.flags.push_back(0), n.dtz.push_back(-1);
+            expand(pos, aux, n);
+            succ.push_back(int32_t(aux) | zeroing);
+        }
+        else if (pos.material_key() == n.key)
+        {
+            std::vector<Piece> pieces = pieces_of(pos);
+            succ.push_back(int32_t(vtb_index(pos, pieces.data(), int(pieces.size()))) | zeroing);
+        }
+        else
+        {
+            std::vector<Piece> pieces = pieces_of(pos);
+            const Table* t = generate(pieces);
+            succ.push_back(t ? fixed(t->values[vtb_index(pos, pieces.data(), int(pieces.size()))])
+                             : FixedDraw);
+        }
+
+        pos.undo_move(m);
+    }
+
+    if (succ.empty())
+    {
+        n.flags[id] = Terminal;
+        n.wdl[id] = int8_t(vtb_terminal(pos.checkers() ? pos.checkmate_value() : pos.stalemate_value()));
+        return;
+    }
+
+    n.begin[id] = uint32_t(n.succ.size());
+    n.succ.insert(n.succ.end(), succ.begin(), succ.end());
+    n.end[id] = uint32_t(n.succ.size());
+}
+
+// Find the wins and losses, then their distance to the next zeroing move
+void VariantTBGenerator::solve(Nodes& n) {
+
+    size_t nodes = n.wdl.size();
+
+    for (bool changed = true; changed; )
+    {
+        changed = false;
+
+        for (size_t id = 0; id < nodes; ++id)
+        {
+            if (n.flags[id] || n.wdl[id])
+                continue;
+
+            bool anyLoss = false, allWin = true;
+            for (uint32_t k = n.begin[id]; k < n.end[id] && !anyLoss; ++k)
+            {
+                int w = wdl_of(n, n.succ[k]);
+                anyLoss = w < 0;
+                allWin &= w > 0;
+            }
+
+            if (anyLoss || allWin)
+                n.wdl[id] = anyLoss ? 1 : -1, changed = true;
+        }
+    }
+
+    std::vector<uint32_t> pending;
+    for (size_t id = 0; id < nodes; ++id)
+        if (n.flags[id] & Terminal)
+            n.dtz[id] = 0;
+        else if (n.wdl[id])
+            pending.push_back(uint32_t(id));
+
+    // A win in r plies has a successor lost in r - 1 plies, a loss in r plies
+    // has only successors that are won, in at most r - 1 plies.
+    for (int r = 1; !pending.empty() && r < 0x7FFF; ++r)
+    {
+        size_t j = 0;
+
+        for (uint32_t id : pending)
+        {
+            bool done = n.wdl[id] < 0;
+            int maxDist = -1;
+
+            for (uint32_t k = n.begin[id]; k < n.end[id]; ++k)
+            {
+                int32_t s = n.succ[k];
+                int d = dist_of(n, s);
+
+                if (n.wdl[id] > 0 && wdl_of(n, s) < 0 && d == r - 1)
+                {
+                    done = true;
+                    break;
+                }
+                if (n.wdl[id] < 0)
+                {
+                    done &= d >= 0;
+                    maxDist = std::max(maxDist, d);
+                }
+            }
+
+            if (done && (n.wdl[id] > 0 || maxDist == r - 1))
+                n.dtz[id] = int16_t(r);
+            else
+                pending[j++] = id;
+        }
+
+        pending.resize(j);
+    }
+}
+
+bool VariantTBGenerator::write(const Table& t) const {
+
+    std::string fname = dir + "/" + variantName + "_" + t.code + ".vtb";
+    std::ofstream file(fname, std::ios::binary);
+    uint8_t header[VTBHeaderSize] = { 0x5A, 0x3C, 0x91, 0xE7,
+                                      uint8_t(t.pieces.size()), uint8_t(v->maxFile + 1), uint8_t(v->maxRank + 1) };
+
+    for (size_t i = 0; i < t.pieces.size(); ++i)
+        header[8 + i] = uint8_t(v->pieceToChar[t.pieces[i]]);
+
+    // Values are written in the byte order of the host, like the transposition
+    // table by savehash.
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)t.values.data(), t.values.size() * sizeof(int16_t));
+
+    sync_cout << "info string " << (file ? "Generated " : "Could not write ") << fname << sync_endl;
+    return bool(file);
+}
+
+const VariantTBGenerator::Table* VariantTBGenerator::generate(const std::vector<Piece>& pieces) {
+
+    StateInfo st;
+    Position pos;
+    Nodes n;
+    n.key = pos.set(v, vtb_fen(v, pieces, nullptr, WHITE), false, &st, th).material_key();
+
+    if (tables.count(n.key))
+        return tables[n.key].get();
+
+    int files = v->maxFile + 1, nsq = files * (v->maxRank + 1);
+    uint64_t size = 2;
+    for (size_t i = 0; i < pieces.size() && size <= VTBMaxSize; ++i)
+        size *= nsq;
+
+    std::unique_ptr<Table> t(new Table{ code_of(pieces), pieces, {} });
+
+    if (failed || pieces.size() > VTBPieces || size > VTBMaxSize)
+    {
+        if (!failed)
+            sync_cout << "info string Table " << t->code << " is too large" << sync_endl;
+        failed = true;
+        return nullptr;
+    }
+
+    n.begin.resize(size), n.end.resize(size), n.wdl.resize(size);
+    n.flags.resize(size), n.dtz.resize(size, -1);
+
+    for (uint64_t idx = 0; idx < size; ++idx)
+    {
+        Square sq[VTBPieces];
+        Bitboard occupied = 0;
+        bool valid = true;
+        uint64_t rest = idx / 2;
+
+        for (size_t i = 0; i < pieces.size(); ++i, rest /= nsq)
+        {
+            sq[i] = make_square(File(rest % nsq % files), Rank(rest % nsq / files));
+
+            // Pawns cannot stand on the last rank
+            valid &=   !(occupied & sq[i])
+                    && (   type_of(pieces[i]) != PAWN
+                        || relative_rank(color_of(pieces[i]), sq[i], v->maxRank) != v->maxRank);
+            occupied |= sq[i];
+        }
+
+        // The side that has just moved cannot be in check
+        Color us = Color(idx & 1);
+        if (valid)
+        {
+            pos.set(v, vtb_fen(v, pieces, sq, us), false, &st, th);
+            valid = !pos.count<KING>(~us) || !pos.attackers_to(pos.square<KING>(~us), us);
+        }
+
+        if (!valid)
+            n.flags[idx] = Invalid;
+        else
+            expand(pos, uint32_t(idx), n);
+
+        if (failed)
+            return nullptr;
+    }
+
+    solve(n);
+
+    t->values.resize(size);
+    for (uint64_t idx = 0; idx < size; ++idx)
+        t->values[idx] = int16_t(n.wdl[idx] * (n.dtz[idx] + 1));
+
+    if (!write(*t))
+        failed = true;
+
+    return (tables[n.key] = std::move(t)).get();
+}
+
+} // namespace
+
+
+/// Tablebases::generate() generates the variant tables for the given material,
+/// e.g., "KMvK", and for all the tables reached from it by captures and promotions.
+/// The files are written to the first directory of "SyzygyPath".
+
+bool Tablebases::generate(const Position& pos, const std::string& code) {
+
+#ifndef _WIN32
+    constexpr char SepChar = ':';
+#else
+    constexpr char SepChar = ';';
+#endif
+    const Variant* v = pos.variant();
+    std::string dir = TBFile::Paths.substr(0, TBFile::Paths.find(SepChar));
+
+    if (dir.empty() || dir == "<empty>")
+    {
+        sync_cout << "info string SyzygyPath is not set" << sync_endl;
+        return false;
+    }
+
+    if (!vtb_supported(v))
+    {
+        sync_cout << "info string Tablebases are not supported for this variant" << sync_endl;
+        return false;
+    }
+
+    std::vector<Piece> pieces;
+    Color c = WHITE;
+    for (char ch : code)
+    {
+        size_t idx = v->pieceToChar.find(toupper(ch));
+        if (ch == 'v')
+            c = BLACK;
+        else if (idx != std::string::npos && idx && idx < PIECE_TYPE_NB)
+            pieces.push_back(make_piece(c, type_of(Piece(idx))));
+        else
+        {
+            sync_cout << "info string Unknown piece " << ch << " in " << code << sync_endl;
+            return false;
+        }
+    }
+    std::sort(pieces.begin(), pieces.end(), vtb_less);
+
+    return VariantTBGenerator(v, Options["UCI_Variant"], dir, pos.this_thread()).generate(pieces) != nullptr;
+}
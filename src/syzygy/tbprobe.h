@@ -45,13 +45,16 @@ enum ProbeState {
 };
 
 extern int MaxCardinality;
+extern bool RootInTB; // Whether the moves of the last search were ranked by the tables
 
 void init(const std::string& paths);
+void prefetch(const Position& pos);
 WDLScore probe_wdl(Position& pos, ProbeState* result);
 int probe_dtz(Position& pos, ProbeState* result);
 bool root_probe(Position& pos, Search::RootMoves& rootMoves);
 bool root_probe_wdl(Position& pos, Search::RootMoves& rootMoves);
 void rank_root_moves(Position& pos, Search::RootMoves& rootMoves);
+bool generate(const Position& pos, const std::string& code);
 
 inline std::ostream& operator<<(std::ostream& os, const WDLScore v) {
 
@@ -18,9 +18,11 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <algorithm> // For std::count
+#include <algorithm> // For std::all_of, std::count, std::find
 #include <cassert>
+#include <sstream>
 
+#include "book.h"
 #include "movegen.h"
 #include "search.h"
 #include "thread.h"
@@ -37,6 +39,17 @@ ThreadPool Threads; // Global object
 Thread::Thread(size_t n) : idx(n), stdThread(&Thread::idle_loop, this) {
 
   wait_for_search_finished();
+  resize_tables();
+}
+
+
+/// Thread::resize_tables() sets the number of entries of the pawn and material
+/// tables from the UCI options. The thread should not be searching.
+
+void Thread::resize_tables() {
+
+  pawnsTable.resize(size_t(Options["Pawn Table Size"]));
+  materialTable.resize(size_t(Options["Material Table Size"]));
 }
 
 
@@ -61,11 +74,15 @@ void Thread::clear() {
   mainHistory.fill(0);
   captureHistory.fill(0);
 
-  for (auto& to : contHistory)
-      for (auto& h : to)
-          h.get()->fill(0);
+  if (contHistory.size())
+  {
+      contHistory.fill(0);
+      contHistory[NO_PIECE][0].fill(Search::CounterMovePruneThreshold - 1);
+  }
 
-  contHistory[NO_PIECE][0].get()->fill(Search::CounterMovePruneThreshold - 1);
+  pawnsTable.clear_stats();
+  materialTable.clear_stats();
+  stats = SearchStats();
 }
 
 /// Thread::start_searching() wakes up the thread that will start the search
@@ -78,6 +95,21 @@ void Thread::start_searching() {
 }
 
 
+/// Thread::start_clearing() wakes up the thread to clear its own data and its
+/// part of the transposition table, see ThreadPool::clear(). When a variant is
+/// given, the thread instead lays out its histories for it and clears its data,
+/// see ThreadPool::resize_histories(). Like for a search, wait_for_search_finished()
+/// waits until it is done.
+
+void Thread::start_clearing(const Variant* v) {
+
+  std::lock_guard<Mutex> lk(mutex);
+  clearing = searching = true;
+  layoutVariant = v;
+  cv.notify_one();
+}
+
+
 /// Thread::wait_for_search_finished() blocks on the condition variable
 /// until the thread has finished searching.
 
@@ -93,12 +125,7 @@ void Thread::wait_for_search_finished() {
 
 void Thread::idle_loop() {
 
-  // If OS already scheduled us on a different group than 0 then don't overwrite
-  // the choice, eventually we are one of many one-threaded processes running on
-  // some Windows NUMA hardware, for instance in fishtest. To make it simple,
-  // just check if running threads are below a threshold, in this case all this
-  // NUMA machinery is not needed.
-  if (Options["Threads"] >= 8)
+  if (Threads.binding())
       WinProcGroup::bindThisThread(idx);
 
   while (true)
@@ -113,7 +140,17 @@ void Thread::idle_loop() {
 
       lk.unlock();
 
-      search();
+      if (clearing)
+      {
+          if (layoutVariant)
+              contHistory.resize(layoutVariant);
+          else
+              TT.clear(idx, Threads.size());
+          clear();
+          clearing = false;
+      }
+      else
+          search();
   }
 }
 
@@ -131,29 +168,155 @@ void ThreadPool::set(size_t requested) {
   }
 
   if (requested > 0) { // create new thread(s)
-      push_back(new MainThread(0));
-
+      // Construct each thread object from a helper thread running on the same
+      // node as the search thread, so that its tables are allocated and first
+      // touched in node-local memory.
       while (size() < requested)
-          push_back(new Thread(size()));
+          std::thread([this]() {
+              if (binding())
+                  WinProcGroup::bindThisThread(size());
+
+              push_back(size() ? new Thread(size()) : new MainThread(0));
+          }).join();
+
+      // Reallocate the hash with the new threadpool size, before clear()
+      // which also clears it.
+      TT.resize(Options["Hash"]);
+
       clear();
   }
+}
+
+/// ThreadPool::binding() tells whether threads should be bound to processor
+/// groups or NUMA nodes. In "Auto" mode this is done only for 8 or more threads:
+/// if the OS already scheduled us on a different group or node then we don't
+/// overwrite the choice, eventually we are one of many one-threaded processes
+/// running on some NUMA hardware, for instance in fishtest.
+
+bool ThreadPool::binding() const {
+
+  return    Options["Thread Binding"] == "On"
+         || (Options["Thread Binding"] == "Auto" && Options["Threads"] >= 8);
+}
+
+
+/// ThreadPool::stats() returns the hot path counters and the pawn and material
+/// table hit rates summed over all the threads since the last "ucinewgame", as
+/// UCI info strings. Rates are given in permill. The search should not be running.
+
+namespace {
+
+  uint64_t permill(uint64_t n, uint64_t d) { return d ? 1000 * n / d : 0; }
+
+  template<typename Table>
+  void table_stats(std::ostream& os, const ThreadPool& threads, const char* name, Table Thread::*table) {
+
+    uint64_t entries = 0, hits = 0, sharedHits = 0, misses = 0;
+    for (Thread* th : threads)
+    {
+        const Table& t = th->*table;
+        entries += t.size(), hits += t.hits, sharedHits += t.sharedHits, misses += t.misses;
+    }
+
+    uint64_t probes = hits + sharedHits + misses;
+    os << "info string " << name << " table entries " << entries
+       << " probes " << probes << " hits " << hits
+       << " sharedhits " << sharedHits << " misses " << misses
+       << " hitrate " << permill(hits + sharedHits, probes);
+  }
+
+} // namespace
+
+std::string ThreadPool::stats() const {
+
+  SearchStats s = SearchStats();
+  for (Thread* th : *this)
+  {
+      const SearchStats& t = th->stats;
+      s.ttProbes += t.ttProbes, s.ttHits += t.ttHits;
+      s.searchNodes += t.searchNodes, s.qsearchNodes += t.qsearchNodes;
+      s.cutoffs += t.cutoffs, s.firstMoveCutoffs += t.firstMoveCutoffs;
+      s.seeCalls += t.seeCalls;
+      s.legalChecks += t.legalChecks, s.illegalMoves += t.illegalMoves;
+      s.tbProbes += t.tbProbes, s.tbCacheHits += t.tbCacheHits, s.tbStalls += t.tbStalls;
+      s.tbProbeTime += t.tbProbeTime, s.tbMaxProbeTime = std::max(s.tbMaxProbeTime, t.tbMaxProbeTime);
+      for (int i = 0; i < SearchStats::PICK_STAGE_NB; ++i)
+          s.picked[i] += t.picked[i];
+  }
 
-  // Reallocate the hash with the new threadpool size
-  TT.resize(Options["Hash"]);
+  const char* stages[] = { "tt", "goodcapture", "refutation", "quiet", "badcapture",
+                           "evasion", "probcut", "qcapture", "qcheck" };
+  uint64_t pickedMoves = 0;
+  for (uint64_t p : s.picked)
+      pickedMoves += p;
+
+  std::stringstream ss;
+  ss << "info string tt probes " << s.ttProbes << " hitrate " << permill(s.ttHits, s.ttProbes)
+     << "\ninfo string nodes " << s.searchNodes + s.qsearchNodes
+     << " qsearch " << permill(s.qsearchNodes, s.searchNodes + s.qsearchNodes)
+     << "\ninfo string cutoffs " << s.cutoffs
+     << " firstmove " << permill(s.firstMoveCutoffs, s.cutoffs)
+     << "\ninfo string see calls " << s.seeCalls
+     << "\ninfo string legal checks " << s.legalChecks
+     << " rejected " << permill(s.illegalMoves, s.legalChecks)
+     << "\ninfo string tb probes " << s.tbProbes
+     << " cachehits " << permill(s.tbCacheHits, s.tbProbes)
+     << " avgtime " << s.tbProbeTime / std::max(s.tbProbes - s.tbCacheHits, uint64_t(1)) << " ns"
+     << " maxtime " << s.tbMaxProbeTime / 1000 << " us"
+     << " stalls " << s.tbStalls
+     << "\ninfo string picked " << pickedMoves;
+
+  for (int i = 0; i < SearchStats::PICK_STAGE_NB; ++i)
+      ss << " " << stages[i] << " " << permill(s.picked[i], pickedMoves);
+
+  ss << "\n";
+  table_stats(ss, *this, "pawn", &Thread::pawnsTable);
+  ss << "\n";
+  table_stats(ss, *this, "material", &Thread::materialTable);
+
+  return ss.str();
 }
 
+
 /// ThreadPool::clear() sets threadPool data to initial values.
 
 void ThreadPool::clear() {
 
+  // Each thread clears its data and its part of the transposition table, so
+  // that all is done in parallel, and in local memory when threads are bound.
   for (Thread* th : *this)
-      th->clear();
+      th->start_clearing();
+
+  Pawns::Shared.clear();
+  Material::Shared.clear();
+
+  for (Thread* th : *this)
+      th->wait_for_search_finished();
 
   main()->callsCnt = 0;
   main()->previousScore = VALUE_INFINITE;
   main()->previousTimeReduction = 1.0;
 }
 
+/// ThreadPool::resize_histories() lays out the histories of the threads for the
+/// given variant. The threads whose histories are laid out for another variant
+/// resize and clear them in parallel, each in its own memory, as in clear().
+
+void ThreadPool::resize_histories(const Variant* v) {
+
+  if (std::all_of(begin(), end(), [&](Thread* th){ return th->contHistory.variant() == v; }))
+      return;
+
+  main()->wait_for_search_finished();
+
+  for (Thread* th : *this)
+      if (th->contHistory.variant() != v)
+          th->start_clearing(v);
+
+  for (Thread* th : *this)
+      th->wait_for_search_finished();
+}
+
 /// ThreadPool::start_thinking() wakes up main thread waiting in idle_loop() and
 /// returns immediately. Main thread will wake up other threads and start the search.
 
@@ -163,8 +326,10 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   main()->wait_for_search_finished();
 
   stopOnPonderhit = stop = false;
+  stopTime = 0;
   ponder = ponderMode;
   Search::Limits = limits;
+  Search::init(pos.variant()->searchParams);
   Search::RootMoves rootMoves;
 
   for (const auto& m : MoveList<LEGAL>(pos))
@@ -175,6 +340,23 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   if (!rootMoves.empty())
       Tablebases::rank_root_moves(pos, rootMoves);
 
+  // Play a book move without searching when the book knows the position,
+  // unless we are analysing or asked for something else than a move to play.
+  bookMove = false;
+  if (   Options["OwnBook"]
+      && !rootMoves.empty()
+      && !(limits.infinite | limits.mate | limits.perft | limits.batch)
+      && !Options["UCI_AnalyseMode"])
+  {
+      Move m = Book.probe(pos, Options["Best Book Move"]);
+      auto it = std::find(rootMoves.begin(), rootMoves.end(), m);
+      if (m != MOVE_NONE && it != rootMoves.end())
+      {
+          std::swap(rootMoves[0], *it);
+          bookMove = true;
+      }
+  }
+
   // After ownership transfer 'states' becomes empty, so if we stop the search
   // and call 'go' again without setting a new position states.get() == NULL.
   assert(states.get() || setupStates.get());
@@ -186,9 +368,14 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   // some StateInfo fields (previous, pliesFromNull, capturedPiece) that cannot
   // be deduced from a fen string, so set() clears them and to not lose the info
   // we need to backup and later restore setupStates->back(). Note that setupStates
-  // is shared by threads but is accessed in read-only mode.
+  // is shared by threads but is accessed in read-only mode, so the check squares
+  // of the root state and the accumulator of the NNUE evaluation, otherwise
+  // computed on first use, are all set beforehand.
   StateInfo tmp = setupStates->back();
 
+  // Usually already done by the caller, before the clock started
+  resize_histories(pos.variant());
+
   for (Thread* th : *this)
   {
       th->nodes = th->tbHits = th->nmpMinPly = 0;
@@ -198,6 +385,11 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   }
 
   setupStates->back() = tmp;
+  main()->rootPos.set_check_squares();
+  Eval::NNUE::refresh(main()->rootPos);
+
+  for (Thread* th : *this)
+      th->rootPos.set_repetitions();
 
   main()->start_searching();
 }
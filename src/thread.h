@@ -24,6 +24,7 @@
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -35,6 +36,29 @@
 #include "thread_win32.h"
 
 
+/// SearchStats holds the hot path counters of a thread. They are plain counters
+/// written only by their thread, and are summed by ThreadPool::stats() when the
+/// search is not running.
+
+struct SearchStats {
+
+  // Coarse MovePicker stages the picked moves are counted by
+  enum PickStage {
+    PICK_TT, PICK_GOOD_CAPTURE, PICK_REFUTATION, PICK_QUIET, PICK_BAD_CAPTURE,
+    PICK_EVASION, PICK_PROBCUT, PICK_QCAPTURE, PICK_QCHECK, PICK_STAGE_NB
+  };
+
+  uint64_t ttProbes, ttHits;
+  uint64_t searchNodes, qsearchNodes;
+  uint64_t cutoffs, firstMoveCutoffs;
+  uint64_t seeCalls;
+  uint64_t legalChecks, illegalMoves;
+  uint64_t tbProbes, tbCacheHits, tbStalls;
+  uint64_t tbProbeTime, tbMaxProbeTime; // In ns
+  uint64_t picked[PICK_STAGE_NB];
+};
+
+
 /// Thread class keeps together all the thread-related stuff. We use
 /// per-thread pawn and material hash tables so that once we get a
 /// pointer to an entry its life time is unlimited and we don't have
@@ -46,6 +70,8 @@ class Thread {
   ConditionVariable cv;
   size_t idx;
   bool exit = false, searching = true; // Set before starting std::thread
+  bool clearing = false; // Woken up to clear instead of searching
+  const Variant* layoutVariant = nullptr; // When clearing, lay out the histories for it
   std::thread stdThread;
 
 public:
@@ -53,12 +79,15 @@ public:
   virtual ~Thread();
   virtual void search();
   void clear();
+  void resize_tables();
   void idle_loop();
   void start_searching();
+  void start_clearing(const Variant* v = nullptr);
   void wait_for_search_finished();
 
   Pawns::Table pawnsTable;
   Material::Table materialTable;
+  SearchStats stats;
   Endgames endgames;
   size_t pvIdx, pvLast;
   int selDepth, nmpMinPly;
@@ -84,10 +113,15 @@ struct MainThread : public Thread {
 
   void search() override;
   void check_time();
+  void print_pv(Depth depth, Value alpha, Value beta);
+  bool currmove_due();
 
   double bestMoveChanges, previousTimeReduction;
   Value previousScore;
+  Thread* bestThread = this; // Whose first root move was the "bestmove" of the last search
   int callsCnt;
+  TimePoint infoInterval, lastPvTime, lastCurrmoveTime;
+  bool pvPending;
 };
 
 
@@ -99,13 +133,18 @@ struct ThreadPool : public std::vector<Thread*> {
 
   void start_thinking(Position&, StateListPtr&, const Search::LimitsType&, bool = false);
   void clear();
+  void resize_histories(const Variant* v);
   void set(size_t);
+  bool binding() const;
+  std::string stats() const;
 
   MainThread* main()        const { return static_cast<MainThread*>(front()); }
   uint64_t nodes_searched() const { return accumulate(&Thread::nodes); }
   uint64_t tb_hits()        const { return accumulate(&Thread::tbHits); }
 
   std::atomic_bool stop, ponder, stopOnPonderhit;
+  bool bookMove; // The first root move is played from the opening book
+  TimePoint stopTime; // When the GUI asked to stop, written before raising stop
 
 private:
   StateListPtr setupStates;
@@ -25,6 +25,7 @@
 #include "search.h"
 #include "timeman.h"
 #include "uci.h"
+#include "variant.h"
 
 TimeManagement Time; // Our global time management object
 
@@ -32,10 +33,6 @@ namespace {
 
   enum TimeType { OptimumTime, MaxTime };
 
-  constexpr int MoveHorizon   = 50;   // Plan time management at most this many moves ahead
-  constexpr double MaxRatio   = 7.3;  // When in trouble, we can step over reserved time with this ratio
-  constexpr double StealRatio = 0.34; // However we must not steal time from remaining moves over this ratio
-
 
   // move_importance() is a skew-logistic function based on naive statistical
   // analysis of "how many games are still undecided after n half-moves". Game
@@ -52,10 +49,10 @@ namespace {
   }
 
   template<TimeType T>
-  TimePoint remaining(const Position& pos, TimePoint myTime, int movesToGo, int ply, TimePoint slowMover) {
+  TimePoint remaining(const Position& pos, const TimeParams& tp, TimePoint myTime, int movesToGo, int ply, TimePoint slowMover) {
 
-    constexpr double TMaxRatio   = (T == OptimumTime ? 1.0 : MaxRatio);
-    constexpr double TStealRatio = (T == OptimumTime ? 0.0 : StealRatio);
+    const double TMaxRatio   = (T == OptimumTime ? 1.0 : tp.maxRatio / 100.0);
+    const double TStealRatio = (T == OptimumTime ? 0.0 : tp.stealRatio / 100.0);
 
     double moveImportance = (move_importance(pos, ply) * slowMover) / 100.0;
     double otherMovesImportance = 0.0;
@@ -80,9 +77,15 @@ namespace {
 ///  inc == 0 && movestogo != 0 means: x moves in y minutes
 ///  inc >  0 && movestogo == 0 means: x basetime + z increment
 ///  inc >  0 && movestogo != 0 means: x moves in y minutes + z increment
+///
+/// Canadian overtime is sent as "x moves in y minutes" once the main time is
+/// used up. In addition, a byoyomi period may be given that can be used for
+/// every move on top of the main time, but is lost if not used. The horizon
+/// and ratios are taken from the time parameters of the variant.
 
 void TimeManagement::init(const Position& pos, Search::LimitsType& limits, Color us, int ply) {
 
+  const TimeParams& tp = pos.variant()->timeParams;
   TimePoint minThinkingTime = Options["Minimum Thinking Time"];
   TimePoint moveOverhead    = Options["Move Overhead"];
   TimePoint slowMover       = Options["Slow Mover"];
@@ -101,13 +104,14 @@ void TimeManagement::init(const Position& pos, Search::LimitsType& limits, Color
       // Convert from milliseconds to nodes
       limits.time[us] = TimePoint(availableNodes);
       limits.inc[us] *= npmsec;
+      limits.byoyomi *= npmsec;
       limits.npmsec = npmsec;
   }
 
   startTime = limits.startTime;
   optimumTime = maximumTime = std::max(limits.time[us], minThinkingTime);
 
-  const int maxMTG = limits.movestogo ? std::min(limits.movestogo, MoveHorizon) : MoveHorizon;
+  const int maxMTG = limits.movestogo ? std::min(limits.movestogo, tp.moveHorizon) : tp.moveHorizon;
 
   // We calculate optimum time usage for different hypothetical "moves to go" values
   // and choose the minimum of calculated search time values. Usually the greatest
@@ -121,13 +125,31 @@ void TimeManagement::init(const Position& pos, Search::LimitsType& limits, Color
 
       hypMyTime = std::max(hypMyTime, TimePoint(0));
 
-      TimePoint t1 = minThinkingTime + remaining<OptimumTime>(pos, hypMyTime, hypMTG, ply, slowMover);
-      TimePoint t2 = minThinkingTime + remaining<MaxTime    >(pos, hypMyTime, hypMTG, ply, slowMover);
+      TimePoint t1 = minThinkingTime + remaining<OptimumTime>(pos, tp, hypMyTime, hypMTG, ply, slowMover);
+      TimePoint t2 = minThinkingTime + remaining<MaxTime    >(pos, tp, hypMyTime, hypMTG, ply, slowMover);
 
       optimumTime = std::min(t1, optimumTime);
       maximumTime = std::min(t2, maximumTime);
   }
 
+  // The byoyomi of this move cannot be saved for later moves, so spend it
+  // on top of the share of the main time.
+  if (limits.byoyomi)
+  {
+      TimePoint byoyomi = std::max(limits.byoyomi - moveOverhead, TimePoint(0));
+      optimumTime += byoyomi;
+      maximumTime = std::min(maximumTime + byoyomi,
+                             std::max(limits.time[us] + byoyomi - moveOverhead, minThinkingTime));
+  }
+
+  // Drops in a setup phase, e.g. in placement chess, need less time than the
+  // moves of the game itself.
+  if (pos.must_drop() && pos.count_in_hand(us, ALL_PIECES))
+  {
+      optimumTime = optimumTime * tp.setupRatio / 100;
+      maximumTime = maximumTime * tp.setupRatio / 100;
+  }
+
   if (Options["Ponder"])
       optimumTime += optimumTime / 4;
 }
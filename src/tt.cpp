@@ -19,36 +19,68 @@
 */
 
 #include <cstring>   // For std::memset
+#include <fstream>
 #include <iostream>
 #include <thread>
 
 #include "bitboard.h"
 #include "misc.h"
+#include "thread.h"
 #include "tt.h"
 #include "uci.h"
 
 TranspositionTable TT; // Our global transposition table
 
+namespace {
+
+  // Header of the transposition table file format. The clusters follow at a
+  // page aligned offset, so that they can be mapped directly into memory. The
+  // board size of the build and the variant are recorded since the entries
+  // are only meaningful for positions of the same variant.
+  constexpr char FileMagic[8] = { 'F', 'S', 'F', 'H', 'A', 'S', 'H', '\0' };
+  constexpr uint32_t FileVersion = 2;
+  constexpr size_t HeaderSize = 4096;
+
+  struct FileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t clusterSize;
+    uint32_t squareNb;
+    uint32_t generation;
+    uint64_t clusterCount;
+    char     variant[64];
+  };
+
+  static_assert(sizeof(FileHeader) <= HeaderSize, "File header too large");
+
+} // namespace
+
 
 /// TranspositionTable::resize() sets the size of the transposition table,
 /// measured in megabytes. Transposition table consists of a power of 2 number
 /// of clusters and each cluster consists of ClusterSize number of TTEntry.
+/// If 'verbose' is set, the kind of memory obtained is reported.
 
-void TranspositionTable::resize(size_t mbSize) {
+void TranspositionTable::resize(size_t mbSize, bool verbose) {
 
   clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
 
-  free(mem);
-  mem = malloc(clusterCount * sizeof(Cluster) + CacheLineSize - 1);
+  aligned_large_pages_free(table, memSize);
 
-  if (!mem)
+  std::string desc;
+  memSize = clusterCount * sizeof(Cluster);
+  table = static_cast<Cluster*>(aligned_large_pages_alloc(memSize, Options["NUMA Policy"] == "Interleave", desc));
+
+  if (!table)
   {
       std::cerr << "Failed to allocate " << mbSize
                 << "MB for transposition table." << std::endl;
       exit(EXIT_FAILURE);
   }
 
-  table = (Cluster*)((uintptr_t(mem) + CacheLineSize - 1) & ~(CacheLineSize - 1));
+  if (verbose)
+      sync_cout << "info string Hash " << mbSize << " MB allocated with " << desc << sync_endl;
+
   clear();
 }
 
@@ -60,27 +92,129 @@ void TranspositionTable::resize(size_t mbSize) {
 
 void TranspositionTable::clear() {
 
-  const size_t stride = clusterCount / Options["Threads"];
+  const size_t count = Options["Threads"];
   std::vector<std::thread> threads;
-  for (size_t idx = 0; idx < Options["Threads"]; idx++)
-  {
-      const size_t start =  stride * idx,
-                   len =    idx != Options["Threads"] - 1 ?
-                            stride :
-                            clusterCount - start;
-      threads.push_back(std::thread([this, idx, start, len]() {
-          if (Options["Threads"] >= 8)
+  for (size_t idx = 0; idx < count; idx++)
+      threads.push_back(std::thread([this, idx, count]() {
+          if (Threads.binding())
               WinProcGroup::bindThisThread(idx);
-          std::memset(&table[start], 0, len * sizeof(Cluster));
+          clear(idx, count);
       }));
-  }
 
   for (std::thread& th: threads)
       th.join();
 }
 
+
+/// TranspositionTable::clear(idx, count) clears the idx-th of 'count' equal
+/// parts of the table, so that the search threads can each clear a part.
+
+void TranspositionTable::clear(size_t idx, size_t count) {
+
+  const size_t stride = clusterCount / count,
+               start  = stride * idx,
+               len    = idx != count - 1 ? stride : clusterCount - start;
+
+  std::memset(&table[start], 0, len * sizeof(Cluster));
+
+  if (idx == 0)
+      collisionCnt = 0;
+}
+
+
+/// TranspositionTable::save() writes the clusters and the current generation
+/// of the transposition table to a file, to be restored later by load().
+
+bool TranspositionTable::save(const std::string& fname) const {
+
+  FileHeader header = {};
+  std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+  header.version = FileVersion;
+  header.clusterSize = sizeof(Cluster);
+  header.squareNb = SQUARE_NB;
+  header.generation = generation8;
+  header.clusterCount = clusterCount;
+  std::string variant = Options["UCI_Variant"];
+  variant.copy(header.variant, sizeof(header.variant) - 1);
+
+  std::ofstream file(fname, std::ios::binary);
+  std::vector<char> padding(HeaderSize - sizeof(FileHeader));
+  file.write((const char*)&header, sizeof(FileHeader));
+  file.write(padding.data(), padding.size());
+  file.write((const char*)table, clusterCount * sizeof(Cluster));
+
+  sync_cout << "info string Hash " << (file ? "saved to " : "could not be saved to ") << fname << sync_endl;
+  return bool(file);
+}
+
+
+/// TranspositionTable::load() replaces the transposition table by the one
+/// stored in the given file. The table keeps the size it had when it was saved.
+/// Where supported the file is mapped into memory instead of being read, so
+/// that only the pages touched by the search are actually loaded.
+
+bool TranspositionTable::load(const std::string& fname) {
+
+  FileHeader header = {};
+  std::string error;
+  std::ifstream file(fname, std::ios::binary | std::ios::ate);
+  size_t fileSize = file ? size_t(file.tellg()) : 0;
+  file.seekg(0);
+  file.read((char*)&header, sizeof(FileHeader));
+  header.variant[sizeof(header.variant) - 1] = '\0';
+
+  if (!file || std::memcmp(header.magic, FileMagic, sizeof(FileMagic)))
+      error = "not a hash file";
+  else if (header.version != FileVersion || header.clusterSize != sizeof(Cluster))
+      error = "incompatible file version";
+  else if (header.squareNb != SQUARE_NB)
+      error = "saved by a build for a different board size";
+  else if (!(Options["UCI_Variant"] == header.variant))
+      error = "saved for variant " + std::string(header.variant);
+  else if (!header.clusterCount)
+      error = "empty table";
+  else if (   fileSize < HeaderSize
+           || header.clusterCount > (fileSize - HeaderSize) / sizeof(Cluster) // No overflow below
+           || fileSize != HeaderSize + header.clusterCount * sizeof(Cluster))
+      error = "file size does not match the table size";
+
+  if (!error.empty())
+  {
+      sync_cout << "info string Hash file " << fname << " rejected: " << error << sync_endl;
+      return false;
+  }
+
+  size_t size = header.clusterCount * sizeof(Cluster);
+  void* mem = map_file(fname, HeaderSize, size);
+  std::string desc = "mapped from ";
+
+  if (!mem)
+  {
+      mem = aligned_large_pages_alloc(size, Options["NUMA Policy"] == "Interleave", desc);
+      desc = "read from ";
+      if (!mem || !file.seekg(HeaderSize) || !file.read((char*)mem, header.clusterCount * sizeof(Cluster)))
+      {
+          aligned_large_pages_free(mem, size);
+          sync_cout << "info string Hash file " << fname << " could not be read" << sync_endl;
+          return false;
+      }
+  }
+
+  aligned_large_pages_free(table, memSize);
+  table = static_cast<Cluster*>(mem);
+  memSize = size;
+  clusterCount = header.clusterCount;
+  generation8 = uint8_t(header.generation);
+
+  sync_cout << "info string Hash " << memSize / (1024 * 1024) << " MB " << desc << fname << sync_endl;
+  return true;
+}
+
+
 /// TranspositionTable::probe() looks up the current position in the transposition
 /// table. It returns true and a pointer to the TTEntry if the position is found.
+/// Entries whose 16 bit key matches but whose key extension does not are counted
+/// as collisions, they would have been false hits with a plain 16 bit key.
 /// Otherwise, it returns false and a pointer to an empty or least valuable TTEntry
 /// to be replaced later. The replace value of an entry is calculated as its depth
 /// minus 8 times its relative age. TTEntry t1 is considered more valuable than
@@ -94,6 +228,12 @@ TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
   for (int i = 0; i < ClusterSize; ++i)
       if (!tte[i].key16 || tte[i].key16 == key16)
       {
+          if (tte[i].key16 && !tte[i].matches(key))
+          {
+              collisionCnt.fetch_add(1, std::memory_order_relaxed);
+              continue;
+          }
+
           if ((tte[i].genBound8 & 0xFC) != generation8 && tte[i].key16)
               tte[i].genBound8 = uint8_t(generation8 | tte[i].bound()); // Refresh
 
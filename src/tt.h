@@ -21,12 +21,15 @@
 #ifndef TT_H_INCLUDED
 #define TT_H_INCLUDED
 
+#include <atomic>
+
 #include "misc.h"
 #include "types.h"
 
 /// TTEntry struct is the 12 bytes transposition table entry, defined as below:
 ///
-/// move       32 bit
+/// move       26 bit (28 bit for large boards)
+/// key ext.    6 bit  (4 bit for large boards)
 /// key        16 bit
 /// value      16 bit
 /// eval value 16 bit
@@ -36,7 +39,18 @@
 
 struct TTEntry {
 
-  Move  move()  const { return (Move )move32; }
+  // Moves do not need all the bits of the move field, so its high bits are
+  // used to extend the key stored in the entry, which reduces the number of
+  // false positive hash hits at no additional memory cost.
+  static constexpr int MoveBits = 2 * SQUARE_BITS + MOVE_TYPE_BITS + 2 * PIECE_TYPE_BITS;
+  static constexpr int KeyExtBits = 32 - MoveBits;
+  static constexpr uint32_t MoveMask = (1U << MoveBits) - 1;
+
+  static_assert(KeyExtBits > 0, "No spare bits in move field");
+
+  static uint32_t key_ext(Key k) { return uint32_t(k >> (48 - KeyExtBits)) << MoveBits; }
+
+  Move  move()  const { return (Move )(move32 & MoveMask); }
   Value value() const { return (Value)value16; }
   Value eval()  const { return (Value)eval16; }
   Depth depth() const { return (Depth)(depth8 * int(ONE_PLY)); }
@@ -46,12 +60,14 @@ struct TTEntry {
 
     assert(d / ONE_PLY * ONE_PLY == d);
 
+    const bool same = matches(k);
+
     // Preserve any existing move for the same position
-    if (m || (k >> 48) != key16)
-        move32 = (uint32_t)m;
+    if (m || !same)
+        move32 = key_ext(k) | (uint32_t)m;
 
     // Don't overwrite more valuable entries
-    if (  (k >> 48) != key16
+    if (   !same
         || d / ONE_PLY > depth8 - 4
      /* || g != (genBound8 & 0xFC) // Matching non-zero keys are already refreshed by probe() */
         || b == BOUND_EXACT)
@@ -67,6 +83,10 @@ struct TTEntry {
 private:
   friend class TranspositionTable;
 
+  bool matches(Key k) const {
+    return key16 == uint16_t(k >> 48) && (move32 & ~MoveMask) == key_ext(k);
+  }
+
   uint32_t move32;
   uint16_t key16;
   int16_t  value16;
@@ -96,13 +116,17 @@ class TranspositionTable {
   static_assert(CacheLineSize % sizeof(Cluster) == 0, "Cluster size incorrect");
 
 public:
- ~TranspositionTable() { free(mem); }
+ ~TranspositionTable() { aligned_large_pages_free(table, memSize); }
   void new_search() { generation8 += 4; } // Lower 2 bits are used by Bound
   uint8_t generation() const { return generation8; }
   TTEntry* probe(const Key key, bool& found) const;
   int hashfull() const;
-  void resize(size_t mbSize);
+  uint64_t collisions() const { return collisionCnt.load(std::memory_order_relaxed); }
+  void resize(size_t mbSize, bool verbose = false);
   void clear();
+  void clear(size_t idx, size_t count);
+  bool save(const std::string& fname) const;
+  bool load(const std::string& fname);
 
   // The 32 lowest order bits of the key are used to get the index of the cluster
   TTEntry* first_entry(const Key key) const {
@@ -112,8 +136,9 @@ public:
 private:
   size_t clusterCount;
   Cluster* table;
-  void* mem;
+  size_t memSize;
   uint8_t generation8; // Size must be not bigger than TTEntry::genBound8
+  mutable std::atomic<uint64_t> collisionCnt;
 };
 
 extern TranspositionTable TT;
@@ -18,11 +18,18 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef> // For offsetof()
+#include <iomanip>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <string>
+#include <vector>
 
+#include "book.h"
+#include "cluster.h"
 #include "evaluate.h"
 #include "movegen.h"
 #include "position.h"
@@ -36,9 +43,23 @@
 using namespace std;
 
 extern vector<string> setup_bench(const Position&, istream&);
+extern void perft_bench(istream&);
+extern void analyze(istream&);
 
 namespace {
 
+  // The game set up by the last "position" command. GUIs send the whole game
+  // before each search, so when a command continues this game, only its new
+  // moves are played on top of the kept states. The states are owned by the
+  // UCI loop or, after a search was started on them, by the thread pool.
+  struct Game {
+    const Variant* variant;
+    string setup;
+    vector<string> moves;
+    std::deque<StateInfo>* states;
+  } game;
+
+
   // position() is called when engine receives the "position" UCI command.
   // The function sets up the position described in the given FEN string ("fen")
   // or the starting position ("startpos") and then makes the moves given in the
@@ -48,6 +69,7 @@ namespace {
 
     Move m;
     string token, fen;
+    vector<string> moves;
 
     is >> token;
     // Parse as SFEN if specified
@@ -64,14 +86,34 @@ namespace {
     else
         return;
 
-    states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
-    pos.set(variants.find(Options["UCI_Variant"])->second, fen, Options["UCI_Chess960"], &states->back(), Threads.main(), sfen);
+    while (is >> token)
+        moves.push_back(token);
+
+    const Variant* v = variants.find(Options["UCI_Variant"])->second;
+    string setup = string(Options["UCI_Chess960"] ? "960 " : "") + (sfen ? "sfen " : "fen ") + fen;
+
+    if (   game.states
+        && game.variant == v
+        && game.setup == setup
+        && moves.size() >= game.moves.size()
+        && std::equal(game.moves.begin(), game.moves.end(), moves.begin()))
+        moves.erase(moves.begin(), moves.begin() + game.moves.size());
+    else
+    {
+        states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
+        pos.set(v, fen, Options["UCI_Chess960"], &states->back(), Threads.main(), sfen);
+        game = { v, setup, {}, states.get() };
+    }
 
     // Parse move list (if any)
-    while (is >> token && (m = UCI::to_move(pos, token)) != MOVE_NONE)
+    for (string& move : moves)
     {
-        states->emplace_back();
-        pos.do_move(m, states->back());
+        if ((m = UCI::to_move(pos, move)) == MOVE_NONE)
+            break;
+
+        game.states->emplace_back();
+        pos.do_move(m, game.states->back());
+        game.moves.push_back(move);
     }
   }
 
@@ -110,23 +152,33 @@ namespace {
     string token;
     bool ponderMode = false;
 
+    // Histories laid out for another variant are resized and cleared before
+    // the clock starts, this is not part of the thinking time
+    Threads.resize_histories(pos.variant());
+
     limits.startTime = now(); // As early as possible!
 
+    // In USI the first player is called black, but it is white internally
+    const bool usi = Options["Protocol"] == "usi";
+
     while (is >> token)
         if (token == "searchmoves")
             while (is >> token)
                 limits.searchmoves.push_back(UCI::to_move(pos, token));
 
-        else if (token == "wtime")     is >> limits.time[WHITE];
-        else if (token == "btime")     is >> limits.time[BLACK];
-        else if (token == "winc")      is >> limits.inc[WHITE];
-        else if (token == "binc")      is >> limits.inc[BLACK];
+        else if (token == "wtime")     is >> limits.time[usi ? BLACK : WHITE];
+        else if (token == "btime")     is >> limits.time[usi ? WHITE : BLACK];
+        else if (token == "winc")      is >> limits.inc[usi ? BLACK : WHITE];
+        else if (token == "binc")      is >> limits.inc[usi ? WHITE : BLACK];
+        else if (token == "byoyomi")   is >> limits.byoyomi;
         else if (token == "movestogo") is >> limits.movestogo;
         else if (token == "depth")     is >> limits.depth;
         else if (token == "nodes")     is >> limits.nodes;
         else if (token == "movetime")  is >> limits.movetime;
         else if (token == "mate")      is >> limits.mate;
         else if (token == "perft")     is >> limits.perft;
+        else if (token == "threads")   is >> limits.perftThreads;
+        else if (token == "hash")      is >> limits.perftHash;
         else if (token == "infinite")  limits.infinite = 1;
         else if (token == "ponder")    ponderMode = true;
 
@@ -134,11 +186,76 @@ namespace {
   }
 
 
+  // A session keeps the variant and the position of one game, so that a single
+  // process can alternate between several games without losing their setup.
+  // Search threads and the transposition table are shared by all sessions.
+
+  struct Session {
+    string variant;
+    bool chess960;
+    string positionCmd;
+  };
+
+  std::map<string, Session> sessions;
+  string sessionId = "default";
+  string positionCmd = "position startpos";
+
+
+  // session() is called when engine receives the "session" command. It stores
+  // the current session and switches to the given one, which is created with
+  // the start position of the current variant if it does not exist yet.
+
+  void session(Position& pos, istringstream& is, StateListPtr& states) {
+
+    string id, token;
+
+    if (!(is >> id))
+    {
+        sync_cout << "info string session " << sessionId;
+        for (const auto& it : sessions)
+            if (it.first != sessionId)
+                cout << " " << it.first;
+        cout << sync_endl;
+        return;
+    }
+
+    Threads.main()->wait_for_search_finished();
+    sessions[sessionId] = { Options["UCI_Variant"], bool(Options["UCI_Chess960"]), positionCmd };
+    sessionId = id;
+
+    auto it = sessions.find(id);
+    if (it != sessions.end())
+    {
+        if (!(Options["UCI_Variant"] == it->second.variant.c_str()))
+            Options["UCI_Variant"] = it->second.variant;
+        Options["UCI_Chess960"] = string(it->second.chess960 ? "true" : "false");
+        positionCmd = it->second.positionCmd;
+    }
+    else
+        positionCmd = "position startpos";
+
+    istringstream ss(positionCmd);
+    ss >> token; // Consume "position" token
+    position(pos, ss, states);
+  }
+
+
+  // stats() is called when engine receives the "stats" command. It prints the
+  // search counters and eval table hit rates of all the threads.
+
+  void stats() {
+
+    Threads.main()->wait_for_search_finished();
+    sync_cout << Threads.stats() << sync_endl;
+  }
+
+
   // bench() is called when engine receives the "bench" command. Firstly
   // a list of UCI commands is setup according to bench parameters, then
-  // it is run one by one printing a summary at the end.
+  // it is run one by one printing a summary at the end. The total number of
+  // nodes and the elapsed time are returned for smpbench().
 
-  void bench(Position& pos, istream& args, StateListPtr& states) {
+  std::pair<uint64_t, TimePoint> bench(Position& pos, istream& args, StateListPtr& states) {
 
     string token;
     uint64_t num, nodes = 0, cnt = 1;
@@ -161,7 +278,7 @@ namespace {
             nodes += Threads.nodes_searched();
         }
         else if (token == "setoption")  setoption(is);
-        else if (token == "position")   position(pos, is, states);
+        else if (token == "position")   position(pos, is, states), positionCmd = cmd;
         else if (token == "ucinewgame") Search::clear();
     }
 
@@ -172,7 +289,148 @@ namespace {
     cerr << "\n==========================="
          << "\nTotal time (ms) : " << elapsed
          << "\nNodes searched  : " << nodes
-         << "\nNodes/second    : " << 1000 * nodes / elapsed << endl;
+         << "\nNodes/second    : " << 1000 * nodes / elapsed
+         << "\nHash full       : " << TT.hashfull()
+         << "\nHash collisions : " << TT.collisions()
+         << "\nStateInfo size  : " << sizeof(StateInfo) << " bytes, "
+                                    << offsetof(StateInfo, key) << " copied per move" << endl;
+
+    return std::make_pair(nodes, elapsed);
+  }
+
+
+  // smpbench() is called when engine receives the "smpbench" command. It runs
+  // the bench with 1, 2, 4... threads up to the given number, the current
+  // number of threads by default, and reports the speedup of each run over
+  // the single threaded one. The search overhead is the share of nodes searched
+  // in excess of the single threaded run, i.e. work duplicated by the threads.
+  //
+  // smpbench [variant] [threads] [depth=13] [hash=16]
+
+  void smpbench(Position& pos, istream& args, StateListPtr& states) {
+
+    string token, varname;
+
+    streampos start = args.tellg();
+    if ((args >> token) && variants.find(token) != variants.end())
+        varname = token + " ";
+    else
+        args.clear(), args.seekg(start);
+
+    // The other arguments are positive numbers, the threads at most the
+    // maximum of the Threads option
+    int userThreads = int(Options["Threads"]), userHash = int(Options["Hash"]);
+    int values[] = { userThreads, 13, 16 }; // Threads, depth and hash
+
+    for (int& v : values)
+        if (args >> token)
+        {
+            istringstream is(token);
+            if (!(is >> v) || !is.eof() || v <= 0 || (&v == values && v > 512))
+            {
+                sync_cout << "info string Invalid smpbench argument " << token << sync_endl;
+                return;
+            }
+        }
+
+    size_t maxThreads = size_t(values[0]);
+    vector<size_t> threadCounts;
+    for (size_t t = 1; t < maxThreads; t *= 2)
+        threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    vector<std::pair<uint64_t, TimePoint>> results;
+    for (size_t t : threadCounts)
+    {
+        istringstream is(varname + std::to_string(values[2]) + " " + std::to_string(t) + " " + std::to_string(values[1]));
+        results.push_back(bench(pos, is, states));
+    }
+
+    // Give back the thread pool and the hash size the bench was started with
+    Options["Threads"] = std::to_string(userThreads);
+    Options["Hash"] = std::to_string(userHash);
+
+    stringstream ss;
+    ss << "\n" << setw(7) << "Threads" << setw(12) << "Time (ms)" << setw(12) << "Nodes"
+              << setw(12) << "Nodes/s" << setw(9) << "Speedup" << setw(10) << "NpsScale"
+              << setw(13) << "Overhead (%)" << fixed;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        double nodes = double(results[i].first), elapsed = double(results[i].second);
+        double nodes1 = double(results[0].first), elapsed1 = double(results[0].second);
+
+        ss << "\n" << setw(7) << threadCounts[i] << setw(12) << results[i].second
+             << setw(12) << results[i].first << setw(12) << uint64_t(1000 * nodes / elapsed)
+             << setprecision(2) << setw(9) << elapsed1 / elapsed
+             << setw(10) << (nodes / elapsed) / (nodes1 / elapsed1)
+             << setprecision(1) << setw(13) << 100 * (nodes / nodes1 - 1);
+    }
+
+    sync_cout << ss.str() << sync_endl;
+  }
+
+
+  // variantbench() is called when engine receives the "variantbench" command.
+  // It runs the bench on a weighted mix of variants with a node limit per
+  // position and reports the speed of each variant. Chess searches the default
+  // bench positions, the other variants their start position, for the given
+  // number of nodes times their weight. It is the workload of profile-build,
+  // so that drops, shogi, the Asian variants and large boards get profiled too.
+  //
+  // variantbench [nodes=100000] [hash=16]
+
+  void variantbench(Position& pos, istream& args, StateListPtr& states) {
+
+    // Variants that are not in the build, e.g. the large-board ones, are skipped
+    const vector<std::pair<string, int>> mix = {
+        { "chess", 1 }, { "crazyhouse", 8 }, { "makruk", 6 }, { "sittuyin", 4 },
+        { "shatranj", 2 }, { "minishogi", 4 }, { "kyotoshogi", 4 }, { "3check", 2 },
+        { "giveaway", 2 }, { "horde", 2 }, { "shogi", 8 }, { "capablanca", 6 },
+        { "courier", 2 }
+    };
+
+    // Both arguments are positive numbers, a node limit of 0 would not stop
+    string token;
+    int values[] = { 100000, 16 }; // Nodes and hash
+
+    for (int& v : values)
+        if (args >> token)
+        {
+            istringstream is(token);
+            if (!(is >> v) || !is.eof() || v <= 0)
+            {
+                sync_cout << "info string Invalid variantbench argument " << token << sync_endl;
+                return;
+            }
+        }
+
+    uint64_t nodesLimit = uint64_t(values[0]);
+    string hash = std::to_string(values[1]);
+
+    stringstream ss;
+    ss << "\n" << left << setw(12) << "Variant" << right << setw(12) << "Time (ms)"
+       << setw(12) << "Nodes" << setw(12) << "Nodes/s";
+
+    uint64_t nodes = 0;
+    TimePoint elapsed = 0;
+
+    for (const auto& v : mix)
+        if (variants.find(v.first) != variants.end())
+        {
+            istringstream is(v.first + " " + hash + " 1 " + std::to_string(v.second * nodesLimit) + " default nodes");
+            auto result = bench(pos, is, states);
+            nodes += result.first;
+            elapsed += result.second;
+
+            ss << "\n" << left << setw(12) << v.first << right << setw(12) << result.second
+               << setw(12) << result.first << setw(12) << 1000 * result.first / result.second;
+        }
+
+    ss << "\n" << left << setw(12) << "Total" << right << setw(12) << elapsed
+       << setw(12) << nodes << setw(12) << 1000 * nodes / std::max(elapsed, TimePoint(1));
+
+    sync_cout << ss.str() << sync_endl;
   }
 
 } // namespace
@@ -198,7 +456,7 @@ void UCI::loop(int argc, char* argv[]) {
       cmd += std::string(argv[i]) + " ";
 
   do {
-      if (argc == 1 && !getline(cin, cmd)) // Block here waiting for input or EOF
+      if (argc == 1 && !Cluster::getline(cin, cmd)) // Block here waiting for input or EOF
           cmd = "quit";
 
       istringstream is(cmd);
@@ -214,7 +472,10 @@ void UCI::loop(int argc, char* argv[]) {
       if (    token == "quit"
           ||  token == "stop"
           || (token == "ponderhit" && Threads.stopOnPonderhit))
+      {
+          Threads.stopTime = now();
           Threads.stop = true;
+      }
 
       else if (token == "ponderhit")
           Threads.ponder = false; // Switch to normal search
@@ -229,15 +490,59 @@ void UCI::loop(int argc, char* argv[]) {
 
       else if (token == "setoption")  setoption(is);
       else if (token == "go")         go(pos, is, states);
-      else if (token == "position")   position(pos, is, states);
+      else if (token == "position")   position(pos, is, states), positionCmd = cmd;
       else if (token == "ucinewgame" || token == "usinewgame") Search::clear();
       else if (token == "isready")    sync_cout << "readyok" << sync_endl;
 
       // Additional custom non-UCI commands, mainly for debugging
-      else if (token == "flip")  pos.flip();
+      else if (token == "flip")  pos.flip(), game.states = nullptr; // States were overwritten
       else if (token == "bench") bench(pos, is, states);
+      else if (token == "smpbench") smpbench(pos, is, states);
+      else if (token == "variantbench") variantbench(pos, is, states);
       else if (token == "d")     sync_cout << pos << sync_endl;
       else if (token == "eval")  sync_cout << Eval::trace(pos) << sync_endl;
+      else if (token == "session") session(pos, is, states);
+      else if (token == "stats")   stats();
+      else if (token == "analyze")
+      {
+          Threads.main()->wait_for_search_finished();
+          analyze(is);
+
+          // The searches replaced the states kept by the thread pool, which
+          // the current position may refer to, so it is set up again.
+          game = {};
+          istringstream ss(positionCmd);
+          ss >> token; // Consume "position" token
+          position(pos, ss, states);
+      }
+      else if (token == "perftbench")
+      {
+          Threads.main()->wait_for_search_finished();
+          perft_bench(is);
+      }
+      else if (token == "makebook")
+      {
+          Threads.main()->wait_for_search_finished();
+          Book.make(pos, is);
+      }
+      else if (token == "tbgen")
+      {
+          string code;
+          is >> code;
+          Threads.main()->wait_for_search_finished();
+          if (Tablebases::generate(pos, code))
+              Tablebases::init(Options["SyzygyPath"]);
+      }
+      else if (token == "savehash" || token == "loadhash")
+      {
+          string fname;
+          getline(is >> ws, fname);
+          Threads.main()->wait_for_search_finished();
+          if (token == "savehash")
+              TT.save(fname);
+          else
+              TT.load(fname);
+      }
       else
           sync_cout << "Unknown command: " << cmd << sync_endl;
 
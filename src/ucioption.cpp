@@ -22,7 +22,9 @@
 #include <cassert>
 #include <iostream>
 
+#include "book.h"
 #include "misc.h"
+#include "nnue.h"
 #include "search.h"
 #include "thread.h"
 #include "tt.h"
@@ -34,21 +36,37 @@ using std::string;
 
 UCI::OptionsMap Options; // Global object
 
-namespace PSQT {
-  void init(const Variant* v);
-}
-
 namespace UCI {
 
 /// 'On change' actions, triggered by an option's value change
 void on_clear_hash(const Option&) { Search::clear(); }
-void on_hash_size(const Option& o) { TT.resize(o); }
+void on_hash_size(const Option& o) { TT.resize(o, true); }
+void on_numa_policy(const Option&) { TT.resize(Options["Hash"], true); }
 void on_logger(const Option& o) { start_logger(o); }
 void on_threads(const Option& o) { Threads.set(o); }
+void on_eval_cache(const Option& o) {
+    Threads.main()->wait_for_search_finished();
+    Pawns::Shared.resize(o);
+    Material::Shared.resize(o);
+}
+void on_eval_tables(const Option&) {
+    Threads.main()->wait_for_search_finished();
+    for (Thread* th : Threads)
+        th->resize_tables();
+}
+void on_thread_binding(const Option&) { Threads.set(Options["Threads"]); }
 void on_tb_path(const Option& o) { Tablebases::init(o); }
+void on_book_path(const Option&) { Book.clear(); }
+void on_nnue_path(const Option&) {
+    Threads.main()->wait_for_search_finished();
+    Eval::NNUE::init();
+}
+void on_search_params(const Option& o) {
+    if (string(o) != "<empty>")
+        variants.load_params(o);
+}
 void on_variant_change(const Option &o) {
     const Variant* v = variants.find(o)->second;
-    PSQT::init(v);
     sync_cout << "info string variant " << (std::string)o
               << " files " << v->maxFile + 1
               << " ranks " << v->maxRank + 1
@@ -56,6 +74,7 @@ void on_variant_change(const Option &o) {
               << " template " << v->variantTemplate
               << " startpos " << v->startFen
               << sync_endl;
+    on_nnue_path(o);
 }
 
 
@@ -79,8 +98,17 @@ void init(OptionsMap& o) {
   o["Contempt"]              << Option(21, -100, 100);
   o["Analysis Contempt"]     << Option("Both", {"Both", "Off", "White", "Black"});
   o["Threads"]               << Option(1, 1, 512, on_threads);
+  o["Thread Binding"]        << Option("Auto", {"Auto", "On", "Off"}, on_thread_binding);
+  o["SMP Scheme"]            << Option("Skip Blocks", {"Skip Blocks", "Alternate", "None"});
+  o["SMP Root Split"]        << Option(false);
   o["Hash"]                  << Option(16, 1, MaxHashMB, on_hash_size);
   o["Clear Hash"]            << Option(on_clear_hash);
+  o["NUMA Policy"]           << Option("First Touch", {"First Touch", "Interleave"}, on_numa_policy);
+  o["Shared Eval Cache"]     << Option(0, 0, 1024, on_eval_cache);
+  o["Pawn Table Size"]       << Option(16384, 256, 1 << 22, on_eval_tables);
+  o["Material Table Size"]   << Option(8192, 256, 1 << 22, on_eval_tables);
+  o["Search Stats"]          << Option(false);
+  o["Info Interval"]         << Option(0, 0, 60000);
   o["Ponder"]                << Option(false);
   o["MultiPV"]               << Option(1, 1, 500);
   o["Skill Level"]           << Option(20, 0, 20);
@@ -91,10 +119,16 @@ void init(OptionsMap& o) {
   o["UCI_Chess960"]          << Option(false);
   o["UCI_Variant"]           << Option("chess", variants.get_keys(), on_variant_change);
   o["UCI_AnalyseMode"]       << Option(false);
+  o["Search Params File"]    << Option("<empty>", on_search_params);
+  o["NNUE Path"]             << Option("<empty>", on_nnue_path);
   o["SyzygyPath"]            << Option("<empty>", on_tb_path);
   o["SyzygyProbeDepth"]      << Option(1, 1, 100);
   o["Syzygy50MoveRule"]      << Option(true);
   o["SyzygyProbeLimit"]      << Option(6, 0, 6);
+  o["SyzygyPrefetch"]        << Option(true);
+  o["OwnBook"]               << Option(false);
+  o["Book Path"]             << Option("<empty>", on_book_path);
+  o["Best Book Move"]        << Option(false);
 }
 
 
@@ -16,8 +16,13 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <fstream>
+#include <iostream>
+#include <sstream>
 #include <string>
 
+#include "misc.h"
+#include "position.h"
 #include "variant.h"
 
 using std::string;
@@ -222,6 +227,7 @@ VariantMap variants; // Global object
         v->blackDropRegion = Rank8BB;
         v->dropOppositeColoredBishop = true;
         v->castlingDroppedPiece = true;
+        v->timeParams.setupRatio = 50;
         return v;
     }
     Variant* sittuyin_variant() {
@@ -238,6 +244,7 @@ VariantMap variants; // Global object
         v->promotionRank = RANK_1; // no regular promotions
         v->sittuyinPromotion = true;
         v->immobilityIllegal = false;
+        v->timeParams.setupRatio = 50;
         return v;
     }
     Variant* minishogi_variant_base() {
@@ -433,6 +440,7 @@ VariantMap variants; // Global object
         v->stalemateValue = VALUE_DRAW;
         v->immobilityIllegal = false;
         v->connectN = 4;
+        v->timeParams.moveHorizon = 21; // At most 21 moves per side
         return v;
     }
     Variant* tictactoe_variant() {
@@ -449,6 +457,7 @@ VariantMap variants; // Global object
         v->stalemateValue = VALUE_DRAW;
         v->immobilityIllegal = false;
         v->connectN = 3;
+        v->timeParams.moveHorizon = 5;
         return v;
     }
 #ifdef LARGEBOARDS
@@ -593,8 +602,10 @@ void VariantMap::init() {
 #endif
 }
 
-void VariantMap::add(std::string s, const Variant* v) {
-  insert(std::pair<std::string, const Variant*>(s, v));
+void VariantMap::add(std::string s, Variant* v) {
+  PSQT::init(v);
+  Position::init(v);
+  insert(std::pair<std::string, const Variant*>(s, v->conclude()));
 }
 
 void VariantMap::clear_all() {
@@ -603,6 +614,128 @@ void VariantMap::clear_all() {
   clear();
 }
 
+namespace {
+
+  // A parameter that can be set in a parameter file, with its valid range
+  template<typename T>
+  struct Param {
+    const char* name;
+    int T::* member;
+    int minValue, maxValue;
+  };
+
+  // set_param() sets the parameter called 'key' if it is in the given table,
+  // unless the value is out of its range, which is reported in 'error'.
+  template<typename T, size_t N>
+  bool set_param(const Param<T> (&table)[N], T& params, const std::string& key, int value, std::string& error) {
+
+    for (const Param<T>& p : table)
+        if (key == p.name)
+        {
+            if (value < p.minValue || value > p.maxValue)
+                error = key + " = " + std::to_string(value) + " out of range ["
+                      + std::to_string(p.minValue) + ", " + std::to_string(p.maxValue) + "]";
+            else
+                params.*(p.member) = value;
+            return true;
+        }
+
+    return false;
+  }
+
+} // namespace
+
+
+/// VariantMap::load_params() reads search and time management parameters from a
+/// file, where each section starts with the variant name in brackets and is
+/// followed by lines of the form "name = value", e.g.
+///
+///   [crazyhouse]
+///   futilityMargin = 150
+///   moveHorizon = 40
+///
+/// Empty lines and lines starting with '#' are ignored. Parameters not given
+/// in the file keep their current values. Nothing is changed if an error is found,
+/// e.g. a value out of the range of the parameter.
+
+bool VariantMap::load_params(const std::string& path) {
+
+  static const Param<SearchParams> Params[] = {
+      { "razorMargin1",      &SearchParams::razorMargin1,      0, 10000 },
+      { "razorMargin2",      &SearchParams::razorMargin2,      0, 10000 },
+      { "futilityMargin",    &SearchParams::futilityMargin,    0, 10000 },
+      { "futilityImproving", &SearchParams::futilityImproving, 0, 10000 },
+      { "reductionDivisor",  &SearchParams::reductionDivisor,  1, 10000 } // A divisor
+  };
+
+  static const Param<TimeParams> TParams[] = {
+      { "moveHorizon",       &TimeParams::moveHorizon,       1, 1000 },
+      { "maxRatio",          &TimeParams::maxRatio,        100, 10000 }, // Not below the optimum time
+      { "stealRatio",        &TimeParams::stealRatio,        0, 100 },
+      { "setupRatio",        &TimeParams::setupRatio,        1, 100 }
+  };
+
+  std::ifstream file(path);
+  std::map<std::string, std::pair<SearchParams, TimeParams>> params;
+  std::string line, error, name;
+  int lineNb = 0;
+
+  if (!file)
+      error = "could not be read";
+
+  while (error.empty() && std::getline(file, line))
+  {
+      std::istringstream ss(line);
+      std::string key;
+      int value;
+
+      ++lineNb;
+      if (!(ss >> key) || key[0] == '#')
+          continue;
+
+      if (key.front() == '[' && key.back() == ']')
+      {
+          name = key.substr(1, key.size() - 2);
+          if (find(name) == end())
+              error = "unknown variant " + name + " at line " + std::to_string(lineNb);
+          else if (!params.count(name))
+              params[name] = std::make_pair(find(name)->second->searchParams,
+                                            find(name)->second->timeParams);
+          continue;
+      }
+
+      size_t eq = line.find('=');
+      std::istringstream ks(line.substr(0, eq)), vs(eq != std::string::npos ? line.substr(eq + 1) : "");
+
+      if (name.empty())
+          error = "parameter outside of a variant section";
+      else if (eq == std::string::npos || !(ks >> key) || !(vs >> value))
+          error = "expected name = value";
+      else if (   !set_param(Params, params[name].first, key, value, error)
+               && !set_param(TParams, params[name].second, key, value, error))
+          error = "unknown parameter " + key;
+
+      if (!error.empty())
+          error += " at line " + std::to_string(lineNb);
+  }
+
+  if (!error.empty())
+  {
+      sync_cout << "info string Search parameter file " << path << " rejected: " << error << sync_endl;
+      return false;
+  }
+
+  // The variants are owned by the map, see add()
+  for (const auto& p : params)
+  {
+      const_cast<Variant*>(find(p.first)->second)->searchParams = p.second.first;
+      const_cast<Variant*>(find(p.first)->second)->timeParams = p.second.second;
+  }
+
+  sync_cout << "info string Search parameters of " << params.size() << " variants loaded from " << path << sync_endl;
+  return true;
+}
+
 std::vector<std::string> VariantMap::get_keys() {
   std::vector<std::string> keys;
   for (auto const& element : *this)
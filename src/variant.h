@@ -19,6 +19,7 @@
 #ifndef VARIANT_H_INCLUDED
 #define VARIANT_H_INCLUDED
 
+#include <algorithm>
 #include <set>
 #include <map>
 #include <vector>
@@ -29,6 +30,37 @@
 #include "bitboard.h"
 
 
+/// SearchParams stores the pruning and reduction parameters of the search, see
+/// Search::init(). The defaults are the ones tuned for chess, they can be
+/// changed per variant from a search parameter file, see VariantMap::load_params().
+
+struct SearchParams {
+  int razorMargin1 = 590;
+  int razorMargin2 = 604;
+  int futilityMargin = 175;
+  int futilityImproving = 50;
+  int reductionDivisor = 195; // In hundredths
+
+  bool operator==(const SearchParams& p) const {
+      return   razorMargin1 == p.razorMargin1 && razorMargin2 == p.razorMargin2
+            && futilityMargin == p.futilityMargin && futilityImproving == p.futilityImproving
+            && reductionDivisor == p.reductionDivisor;
+  }
+};
+
+
+/// TimeParams stores the parameters of the time management, see TimeManagement::init().
+/// Ratios are given in hundredths. Like the search parameters they can be set per
+/// variant, e.g. for variants with short games or a setup phase.
+
+struct TimeParams {
+  int moveHorizon = 50;  // Plan time management at most this many moves ahead
+  int maxRatio = 730;    // When in trouble, we can step over reserved time with this ratio
+  int stealRatio = 34;   // However we must not steal time from remaining moves over this ratio
+  int setupRatio = 100;  // Share of the normal time used for drops in a setup phase
+};
+
+
 /// Variant struct stores information needed to determine the rules of a variant.
 
 struct Variant {
@@ -89,6 +121,18 @@ struct Variant {
   CheckCount maxCheckCount = CheckCount(0);
   int connectN = 0;
 
+  // Search and time management parameters
+  SearchParams searchParams;
+  TimeParams timeParams;
+
+  // Derived properties
+  bool fastAttacks = true;
+  Score psq[PIECE_NB][SQUARE_NB + 1] = {}; // Piece-square table, see PSQT::init()
+  std::vector<Key> cuckoo;       // Cuckoo tables of the reversible moves, see Position::init()
+  std::vector<Move> cuckooMove;
+  std::vector<PieceType> seeOrder; // Piece types by increasing value, see Position::init()
+  std::vector<PieceType> sliders[2]; // Piece types sliding diagonally and orthogonally
+
   void add_piece(PieceType pt, char c) {
       pieceToChar[make_piece(WHITE, pt)] = toupper(c);
       pieceToChar[make_piece(BLACK, pt)] = tolower(c);
@@ -105,12 +149,26 @@ struct Variant {
       pieceToChar = std::string(PIECE_NB, ' ');
       pieceTypes.clear();
   }
+
+  // Pre-calculate derived properties
+  Variant* conclude() {
+      fastAttacks = std::all_of(pieceTypes.begin(), pieceTypes.end(), [](PieceType pt) {
+                                    return pt <= QUEEN || pt == ARCHBISHOP || pt == CHANCELLOR
+                                        || pt == COMMONER || pt == KING;
+                                });
+      return this;
+  }
 };
 
+namespace PSQT {
+  void init(Variant* v);
+}
+
 struct VariantMap : public std::map<std::string, const Variant*> {
   void init();
-  void add(std::string s, const Variant* v);
+  void add(std::string s, Variant* v);
   void clear_all();
+  bool load_params(const std::string& path);
   std::vector<std::string> get_keys();
 };
 
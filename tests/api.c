@@ -0,0 +1,266 @@
+/*
+  Client of the C interface of the engine library, see src/api.h. It is built
+  and run by api.sh, and exits with a non-zero status at the first failed check.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api.h"
+
+#define CHECK(cond) \
+  do { if (!(cond)) { printf("api check failed on line %d: %s\n", __LINE__, #cond); exit(1); } } while (0)
+
+static const char* StartFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static uint64_t perft(fsf_position* pos, int depth) {
+
+  fsf_move moves[512];
+  size_t n = fsf_legal_moves(pos, moves, 512);
+  uint64_t nodes = 0;
+
+  CHECK(n <= 512);
+  if (depth <= 1)
+      return n;
+
+  for (size_t i = 0; i < n; ++i)
+  {
+      CHECK(fsf_do_move(pos, moves[i]));
+      nodes += perft(pos, depth - 1);
+      CHECK(fsf_undo_move(pos));
+  }
+  return nodes;
+}
+
+static void play(fsf_position* pos, const char* moves) {
+
+  char name[16];
+  const char* s = moves;
+
+  while (sscanf(s, "%15s", name) == 1)
+  {
+      fsf_move m = fsf_to_move(pos, name);
+      CHECK(m);
+      CHECK(fsf_do_move(pos, m));
+      s = strstr(s, name) + strlen(name);
+  }
+}
+
+static void set_up(void) {
+
+  char buf[128];
+  fsf_move moves[64];
+  fsf_position* pos;
+
+  CHECK(!fsf_new_position("nosuchvariant", NULL, 0));
+
+  pos = fsf_new_position("chess", NULL, 0);
+  CHECK(pos);
+  CHECK(fsf_fen(pos, buf, sizeof(buf)) == strlen(StartFen));
+  CHECK(!strcmp(buf, StartFen));
+  CHECK(fsf_side_to_move(pos) == 0);
+  CHECK(!fsf_in_check(pos));
+
+  /* The FEN is truncated like with snprintf() */
+  CHECK(fsf_fen(pos, buf, 9) == strlen(StartFen));
+  CHECK(!strcmp(buf, "rnbqkbnr"));
+
+  /* The moves are counted even when they do not fit */
+  CHECK(fsf_legal_moves(pos, moves, 5) == 20);
+  CHECK(fsf_legal_moves(pos, moves, 64) == 20);
+  CHECK(fsf_move_name(pos, fsf_to_move(pos, "g1f3"), buf, sizeof(buf)) == 4);
+  CHECK(!strcmp(buf, "g1f3"));
+  CHECK(!fsf_to_move(pos, "e2e5"));
+
+  fsf_delete_position(pos);
+
+  pos = fsf_new_position("crazyhouse", "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R[] w KQkq - 2 3", 0);
+  CHECK(pos);
+  CHECK(fsf_legal_moves(pos, moves, 64) == 27);
+  fsf_delete_position(pos);
+}
+
+static void do_undo(void) {
+
+  char buf[128];
+  fsf_position* pos = fsf_new_position("crazyhouse", NULL, 0);
+
+  CHECK(!fsf_undo_move(pos));
+
+  /* A capture puts the piece in hand, and it can be dropped */
+  play(pos, "e2e4 d7d5 e4d5");
+  CHECK(fsf_side_to_move(pos) == 1);
+  CHECK(fsf_fen(pos, buf, sizeof(buf)));
+  CHECK(!strcmp(buf, "rnbqkbnr/ppp1pppp/8/3P4/8/8/PPPP1PPP/RNBQKBNR[P] b KQkq - 0 2"));
+  CHECK(!fsf_to_move(pos, "P@e4"));
+  play(pos, "d8d5 b1c3");
+  CHECK(fsf_to_move(pos, "P@e4"));
+  CHECK(fsf_to_move(pos, "d5e4"));
+
+  /* Taking back all the moves gives the start position again */
+  for (int i = 0; i < 5; ++i)
+      CHECK(fsf_undo_move(pos));
+  CHECK(!fsf_undo_move(pos));
+  CHECK(fsf_fen(pos, buf, sizeof(buf)));
+  CHECK(!strcmp(buf, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR[] w KQkq - 0 1"));
+
+  /* Known perft numbers, see perft.sh */
+  CHECK(perft(pos, 4) == 197281);
+  fsf_delete_position(pos);
+
+  pos = fsf_new_position("chess", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -", 0);
+  CHECK(perft(pos, 4) == 43238);
+  fsf_delete_position(pos);
+}
+
+static void game_end(void) {
+
+  int result = 2;
+  fsf_position* pos = fsf_new_position("chess", NULL, 0);
+
+  CHECK(!fsf_game_end(pos, &result));
+  CHECK(result == 2);
+
+  /* Fool's mate */
+  play(pos, "f2f3 e7e5 g2g4 d8h4");
+  CHECK(fsf_in_check(pos));
+  CHECK(fsf_legal_moves(pos, NULL, 0) == 0);
+  CHECK(fsf_game_end(pos, &result));
+  CHECK(result == -1);
+  fsf_delete_position(pos);
+
+  /* Stalemate */
+  pos = fsf_new_position("chess", "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1", 0);
+  CHECK(fsf_game_end(pos, &result));
+  CHECK(result == 0);
+  fsf_delete_position(pos);
+
+  /* Threefold repetition */
+  pos = fsf_new_position("chess", NULL, 0);
+  play(pos, "g1f3 g8f6 f3g1 f6g8 g1f3 g8f6 f3g1");
+  CHECK(!fsf_game_end(pos, &result));
+  play(pos, "f6g8");
+  CHECK(fsf_game_end(pos, &result));
+  CHECK(result == 0);
+  fsf_delete_position(pos);
+
+  /* Variant rules: in shatranj a bare king loses when it could not bare the
+     other king in its move, in king of the hill reaching the center wins */
+  pos = fsf_new_position("shatranj", "8/8/8/4k3/8/8/8/K6R b - - 0 1", 0);
+  CHECK(!fsf_game_end(pos, &result));
+  fsf_delete_position(pos);
+
+  pos = fsf_new_position("shatranj", "8/8/8/4k3/8/8/8/K6R w - - 0 1", 0);
+  CHECK(fsf_game_end(pos, &result));
+  CHECK(result == 1);
+  fsf_delete_position(pos);
+
+  pos = fsf_new_position("kingofthehill", "8/8/5k2/8/8/8/8/K6R b - - 0 1", 0);
+  CHECK(!fsf_game_end(pos, &result));
+  play(pos, "f6e5");
+  CHECK(fsf_game_end(pos, &result));
+  CHECK(result == -1);
+  fsf_delete_position(pos);
+}
+
+static int OutputLines;
+static char LastLine[256];
+
+static void output(const char* line, void* data) {
+
+  CHECK(data == &OutputLines);
+  ++OutputLines;
+  strncpy(LastLine, line, sizeof(LastLine) - 1);
+}
+
+static void search(void) {
+
+  char buf[16];
+  fsf_limits limits;
+  fsf_result result;
+  fsf_position* pos = fsf_new_position("chess", "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", 0);
+
+  memset(&limits, 0, sizeof(limits));
+  limits.depth = 6;
+  fsf_search(pos, &limits, output, &OutputLines, &result);
+
+  CHECK(fsf_move_name(pos, result.bestmove, buf, sizeof(buf)) == 4);
+  CHECK(!strcmp(buf, "d1d8"));
+  CHECK(result.mate == 1);
+  CHECK(result.nodes > 0);
+  CHECK(OutputLines > 1);
+  CHECK(!strncmp(LastLine, "bestmove d1d8", 13));
+
+  /* The position is not changed by the search */
+  CHECK(fsf_fen(pos, buf, sizeof(buf)) && !strncmp(buf, "6k1/5ppp", 8));
+
+  /* No best move when the game has ended */
+  play(pos, "d1d8");
+  fsf_search(pos, &limits, NULL, NULL, &result);
+  CHECK(!result.bestmove);
+  fsf_delete_position(pos);
+
+  /* An unlimited search runs until it is stopped */
+  pos = fsf_new_position("crazyhouse", NULL, 0);
+  memset(&limits, 0, sizeof(limits));
+  fsf_search_start(pos, &limits, NULL, NULL);
+  fsf_search_stop();
+  fsf_search_wait(&result);
+  CHECK(fsf_to_move(pos, "e2e4"));
+  CHECK(result.bestmove);
+  fsf_delete_position(pos);
+}
+
+/* Positions of different variants are used from several threads, while a
+   search runs in the background */
+
+static void* perft_thread(void* arg) {
+
+  static const char* variants[] = { "chess", "crazyhouse", "makruk", "minishogi" };
+  static const uint64_t counts[] = { 8902, 8902, 12012, 2512 };
+  int i = *(const int*)arg;
+  fsf_position* pos = fsf_new_position(variants[i], NULL, 0);
+
+  CHECK(perft(pos, 3) == counts[i]);
+  fsf_delete_position(pos);
+  return NULL;
+}
+
+static void threads(void) {
+
+  pthread_t th[4];
+  int idx[4] = { 0, 1, 2, 3 };
+  fsf_limits limits;
+  fsf_position* pos = fsf_new_position("sittuyin", NULL, 0);
+
+  CHECK(fsf_set_option("Threads", "2"));
+  CHECK(!fsf_set_option("No Such Option", "1"));
+
+  memset(&limits, 0, sizeof(limits));
+  fsf_search_start(pos, &limits, NULL, NULL);
+
+  for (int i = 0; i < 4; ++i)
+      CHECK(!pthread_create(&th[i], NULL, perft_thread, &idx[i]));
+  for (int i = 0; i < 4; ++i)
+      CHECK(!pthread_join(th[i], NULL));
+
+  fsf_search_stop();
+  fsf_search_wait(NULL);
+  fsf_delete_position(pos);
+}
+
+int main(void) {
+
+  fsf_init();
+
+  set_up();
+  do_undo();
+  game_end();
+  search();
+  threads();
+
+  fsf_exit();
+  return 0;
+}
@@ -0,0 +1,17 @@
+#!/bin/bash
+# verify the C interface of the library, built with "make lib"
+
+error()
+{
+  echo "api testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "api testing started"
+
+cc -std=c99 -Wall -Wextra -pedantic -I. ../tests/api.c -o api_test -L. -lstockfish -lpthread
+LD_LIBRARY_PATH=. ./api_test
+rm api_test
+
+echo "api testing OK"
@@ -0,0 +1,58 @@
+#!/bin/bash
+# verify the loading of NNUE networks and searches with them, using networks
+# of random weights. In debug builds, the accumulators updated in the search
+# are also checked against accumulators computed from scratch.
+
+error()
+{
+  echo "nnue testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "nnue testing started"
+
+netdir=`mktemp -d`
+trap 'rm -rf $netdir' EXIT
+
+# write a network of random weights for a variant with the given number of
+# files, ranks, piece types and inputs for the pieces of a type in hand
+network()
+{
+  perl -e '
+    my ($variant, $files, $ranks, $types, $slots) = @ARGV;
+    my $features = 2 * $types * ($files * $ranks + $slots);
+    sub r { my ($n, $m) = @_; map { int(rand(2 * $m + 1)) - $m } 1 .. $n }
+    print pack("a8 V8 a64", "FSFNNUE", 1, $files, $ranks, $types, $slots, 256, 32, 32, $variant);
+    print pack("s<*", r(256 * ($features + 1), 20));
+    print pack("l<*", r(32, 1000)), pack("c*", r(32 * 512, 20));
+    print pack("l<*", r(32, 1000)), pack("c*", r(32 * 32, 20));
+    print pack("l<*", r(1, 100)), pack("c*", r(32, 40));
+  ' "$@"
+}
+
+network chess 8 8 6 0 > $netdir/chess.nnue
+network crazyhouse 8 8 6 16 > $netdir/crazyhouse.nnue
+network minishogi 5 5 8 4 > $netdir/minishogi.nnue
+network chess 8 8 6 0 > $netdir/3check.nnue
+network kingofthehill 8 8 6 0 | head -c 100000 > $netdir/kingofthehill.nnue
+
+# the network of a variant is loaded when the variant is set, and only used for it
+output=`echo -e "setoption name NNUE Path value $netdir\nsetoption name UCI_Variant value crazyhouse
+position startpos moves e2e4 d7d5 e4d5\neval\nsetoption name UCI_Variant value makruk\nposition startpos\neval\nquit" | ./stockfish`
+echo "$output" | grep "NNUE evaluation using $netdir/crazyhouse.nnue" > /dev/null
+test `echo "$output" | grep -c "^NNUE evaluation:"` = 1
+
+# files that do not fit are rejected
+echo -e "setoption name NNUE Path value $netdir\nsetoption name UCI_Variant value 3check\nquit" | ./stockfish | grep "3check.nnue rejected: made for variant chess" > /dev/null
+echo -e "setoption name NNUE Path value $netdir\nsetoption name UCI_Variant value kingofthehill\nquit" | ./stockfish | grep "kingofthehill.nnue rejected: wrong file size" > /dev/null
+
+# searches with the networks, with captures to hand, drops and promotions
+for variant in chess crazyhouse minishogi
+do
+  classical=`./stockfish bench $variant 16 1 6 2>&1 | grep "Nodes searched"`
+  nnue=`echo -e "setoption name NNUE Path value $netdir\nbench $variant 16 1 6\nquit" | ./stockfish 2>&1 | grep "Nodes searched"`
+  test "$nnue" != "$classical"
+done
+
+echo "nnue testing OK"
@@ -12,8 +12,10 @@ echo "perft testing started"
 
 cat << EOF > perft.exp
    set timeout 30
-   lassign \$argv var pos depth result
+   lassign \$argv var pos depth result threads
+   if {\$threads eq ""} {set threads 1}
    spawn ./stockfish
+   send "setoption name Threads value \$threads\\n"
    send "setoption name UCI_Variant value \$var\\n"
    send "position \$pos\\ngo perft \$depth\\n"
    expect "Nodes searched? \$result" {} timeout {exit 1}
@@ -51,11 +53,20 @@ if [[ $1 == "" || $1 == "variant" ]]; then
   expect perft.exp minishogi startpos 5 533203 > /dev/null
   expect perft.exp horde startpos 6 5396554 > /dev/null
   expect perft.exp placement startpos 4 1597696 > /dev/null
+  expect perft.exp placement "fen r3k3/8/8/8/8/8/8/8[K] w - - 0 1" 1 7 > /dev/null
   expect perft.exp sittuyin startpos 3 580096 > /dev/null
   expect perft.exp sittuyin "fen 8/8/6R1/s3r3/P5R1/1KP3p1/1F2kr2/8[-] b - - 0 72" 4 657824 > /dev/null
   expect perft.exp sittuyin "fen 2r5/6k1/6p1/3s2P1/3npR2/8/p2N2F1/3K4 w - - 1 50" 4 394031 > /dev/null
 fi
 
+# hashed and threaded perft
+if [[ $1 == "" || $1 == "hash" ]]; then
+  expect perft.exp chess startpos "5 hash 16" 4865609 2 > /dev/null
+  expect perft.exp crazyhouse startpos "5 hash 16" 4888832 2 > /dev/null
+  expect perft.exp crazyhouse "fen r3k3/1P6/8/8/8/8/8/Q~3K2R[Nn] w - - 0 1" "4 hash 16" 8418897 2 > /dev/null
+  expect perft.exp minishogi startpos "5 hash 16" 533203 2 > /dev/null
+fi
+
 # large-board variants
 if [[ $1 == "largeboard" ]]; then
   expect perft.exp shogi startpos 4 719731 > /dev/null
@@ -0,0 +1,54 @@
+#!/bin/bash
+# verify the variant tablebases generated by tbgen and their probing
+
+error()
+{
+  echo "tbgen testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "tbgen testing started"
+
+tbdir=`mktemp -d`
+trap 'rm -rf $tbdir' EXIT
+
+# generate the makruk KRvK table, which also needs KvK
+echo -e "setoption name SyzygyPath value $tbdir\nsetoption name UCI_Variant value makruk\ntbgen KRvK\nquit" | ./stockfish > /dev/null
+test -f $tbdir/makruk_KRvK.vtb
+test -f $tbdir/makruk_KvK.vtb
+
+# value of a position in the table: pieces in the order K, R, k, the first one
+# varying fastest, then the side to move, see vtb_index()
+value()
+{
+  entry=$(( 2 * ($1 + 64 * $2 + 4096 * $3) + $4 ))
+  od -An -t d2 -j $(( 16 + 2 * entry )) -N 2 $tbdir/makruk_KRvK.vtb | tr -d ' '
+}
+
+# the rook is a chess rook, so the longest win is a mate in 16 like in chess,
+# stored as 31 plies + 1 for the side to move and 32 plies + 1 for the other side
+test "`od -An -v -t d2 -j 16 $tbdir/makruk_KRvK.vtb | tr -s ' ' '\n' | sort -n | sed -n '2p;$p' | tr '\n' ' '`" = "-33 32 "
+
+# Kb6 Rh1 ka8 white to move is a mate in 1, Kb6 Rh8 ka8 black to move is mated
+test `value 41 7 56 0` = 2
+test `value 41 63 56 1` = -1
+
+# Ka1 Rg2 kh1 black to move is a draw, the rook is lost
+test `value 0 14 7 1` = 0
+
+# probing through a search, wins and losses at the root are reported with the
+# score of a table win, the drawing move is the capture of the rook
+analysis=`echo -e "setoption name SyzygyPath value $tbdir\nsetoption name UCI_Variant value makruk\nanalyze depth 5
+k7/8/1K6/8/8/8/8/7R w - - 0 1
+8/8/8/3k4/8/8/8/K6R w - - 0 1
+8/8/8/3k4/8/8/8/K6R b - - 0 1
+8/8/8/8/8/8/6R1/K6k b - - 0 1
+end\nquit" | ./stockfish | grep "^analysis"`
+
+echo "$analysis" | grep "^analysis 1 .* score mate 1 .* bestmove h1h8" > /dev/null
+echo "$analysis" | grep "^analysis 2 .* score cp 13279 " > /dev/null
+echo "$analysis" | grep "^analysis 3 .* score cp -13279 " > /dev/null
+echo "$analysis" | grep "^analysis 4 .* score cp 0 .* bestmove h1g2" > /dev/null
+
+echo "tbgen testing OK"